@@ -1,10 +1,19 @@
 #include <cstdio>
+#include <cstdlib>
+#include <cctype>
 #include <vector>
 #include <string>
 #include <iostream>
 #include <map>
 #include <set>
 #include <stack>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <chrono>
+#include "semantic.h"
+#include "simplify.h"
+#include "trace.h"
 using namespace std;
 
 /* 产生式结构体 */
@@ -25,14 +34,55 @@ struct Grammar {
 map<char, set<char> > first;
 map<char, set<char> > follow;
 
-/* 分析栈 */
-stack<char> ST;
+/* 产生式右部各个后缀的FIRST集(不含空，按字符排好序)和能否推空，
+ * suffixFirst[i][j]为第i个产生式右部从第j个符号开始的后缀的FIRST集 */
+vector< vector< vector<char> > > suffixFirst;
+vector< vector<bool> > suffixNullable;
+
+/* 分析栈，预先分配好空间，top为栈顶下标 */
+vector<char> ST;
+int top;
+/* 语义动作模式下，展开时在右部下面压入动作标记，MK[i]为ST[i]处标记对应的产生式序号 */
+const char ACTION_MARK = 1;
+vector<int> MK;
 
 /* 待分析串 */
 string str;
 
-/* 预测分析表 */
-vector<char> M[50][50];
+/* 预测分析表，保存产生式序号，-1表示空 */
+int M[50][50];
+
+/* 每个产生式去掉空以后逆序的右部，连续存放在rhsPool中，
+ * 第i个产生式为rhsPool[rhsSpan[i].first]开始的rhsSpan[i].second个符号 */
+vector<char> rhsPool;
+vector< pair<int, int> > rhsSpan;
+
+/* 语义动作模式：输入串中的数字当作终结符n，分析的同时计算值 */
+bool eval = false;
+/* 语义动作和值栈 */
+ValueStack values;
+
+/* --trace 在接受或第一次出错时输出trace.h记录的分析事件 */
+bool trace = false;
+
+/* --latency CORPUS JSON 逐个分析语料中的串，把每个串的分析延迟的分位数和直方图写到JSON文件 */
+string latencyCorpus, latencyJson;
+
+/* 文法变换模式：先消除左递归、提取左公因子，再生成预测分析表，输出时换回原文法的产生式 */
+bool transformed = false;
+/* 变换前的原文法 */
+Grammar source;
+/* 原文法各个产生式右部去掉空以后的符号数 */
+vector<int> sourceLen;
+/* 变换后各个产生式带归约标记的右部，非负为符号，负数-(p+1)为原文法第p个产生式的归约标记 */
+vector< vector<int> > markedRights;
+/* 与rhsPool对应，右部中归约标记处为原文法的产生式序号，其他符号处为-1 */
+vector<int> markPool;
+/* 分析过程中依次弹出的归约标记，即原文法分析树的后序 */
+vector<int> reduced;
+
+/* 语料模式下process()不输出，出错时返回 */
+bool quiet = false;
 
 /* 判断ch是否是终结符 */
 int isInT(char ch)
@@ -162,6 +212,46 @@ void getFirstByAlphaSet(vector<char> &alpha, set<char> &FS)
         FS.insert('&');
     }
 }
+/* 预先求出每个产生式右部每个后缀的FIRST集和能否推空 */
+void getSuffixFirstSet()
+{
+    suffixFirst.assign(grammar.prods.size(), vector< vector<char> >());
+    suffixNullable.assign(grammar.prods.size(), vector<bool>());
+    for (int i = 0; i < grammar.prods.size(); i++) {
+        Production &P = grammar.prods[i];
+        int n = P.rigths.size();
+        suffixFirst[i].assign(n + 1, vector<char>());
+        suffixNullable[i].assign(n + 1, false);
+        /* 空后缀能推空 */
+        suffixNullable[i][n] = true;
+        /* 从后往前求，后缀j的FIRST集为FIRST(X_j)，若X_j能推空则再并上后缀j+1的FIRST集 */
+        for (int j = n - 1; j >= 0; j--) {
+            char X = P.rigths[j];
+            set<char> FS;
+            bool nullable = false;
+            if (X == '&') {
+                nullable = true;
+            } else if (isInT(X)) {
+                FS.insert(X);
+            } else {
+                set<char> &FX = first[X];
+                for (auto it = FX.begin(); it != FX.end(); it++) {
+                    if (*it == '&') {
+                        nullable = true;
+                    } else {
+                        FS.insert(*it);
+                    }
+                }
+            }
+            if (nullable) {
+                FS.insert(suffixFirst[i][j + 1].begin(), suffixFirst[i][j + 1].end());
+                nullable = suffixNullable[i][j + 1];
+            }
+            suffixFirst[i][j].assign(FS.begin(), FS.end());
+            suffixNullable[i][j] = nullable;
+        }
+    }
+}
 /* 求非终结符的FOLLOW集 */
 void getFollowSet()
 {
@@ -185,11 +275,8 @@ void getFollowSet()
                 /* 当前符号是非终结符 */
                 if (isInN(B)) {
                     set<char> &FB = follow[B];
-                    set<char> FS;
-                    /* alpha是从当前符号下一个符号开始的符号串 */
-                    vector<char> alpha(P.rigths.begin() + j + 1, P.rigths.end());
-                    /* 求alpha的FIRST集，即FS */
-                    getFirstByAlphaSet(alpha, FS);
+                    /* 取出预先求好的从当前符号下一个符号开始的后缀的FIRST集 */
+                    vector<char> &FS = suffixFirst[i][j + 1];
                     /* 将alpha的FIRST集中所有非空元素加入到当前符号的FOLLOW集中 */
                     for (auto it = FS.begin(); it != FS.end(); it++) {
                         if (*it == '&') {
@@ -201,9 +288,8 @@ void getFollowSet()
                             FB.insert(*it);
                         }
                     }
-                    /* 如果alpha能推空，或者当前符号是产生式右部末尾，则将文法左部符号的FOLLOW集加入到当前符号的FOLLOW集中 */
-                    auto itt = FS.find('&');
-                    if (itt != FS.end() || (j + 1) >= P.rigths.size()) {
+                    /* 如果alpha能推空(当前符号是产生式右部末尾时alpha为空)，则将文法左部符号的FOLLOW集加入到当前符号的FOLLOW集中 */
+                    if (suffixNullable[i][j + 1]) {
                         char A = P.left;    // A为左部符号
                         for (auto it = follow[A].begin(); it != follow[A].end(); it++) {
                             auto itt = FB.find(*it);
@@ -229,31 +315,85 @@ void getFollowSet()
     }
 }
 /* 把生成式插入到预测分析表对应的项中 */
-void insertTOForecastAnalysisTable(char A, char a, Production &P)
+void insertTOForecastAnalysisTable(char A, char a, int p)
 {
     /* 根据A和a找到对应表项 */
     int i = isInN(A) - 1;
     int j = isInT(a) - 1;
-    /* 把P.left->P.rights插入*/
-    M[i][j].push_back(P.left);
-    M[i][j].push_back('-');
-    M[i][j].push_back('>');
-    for (auto it = P.rigths.begin(); it != P.rigths.end(); it++) {
-        M[i][j].push_back(*it);
+    /* 空不是终结符，没有对应的列 */
+    if (j < 0)
+        return;
+    /* 表项已有其他产生式，不是LL1文法 */
+    if (M[i][j] >= 0 && M[i][j] != p) {
+        printf("conflict at M[%c, %c]\n", A, a);
+        return;
     }
+    M[i][j] = p;
 }
-/* 取出预测分析表对应的项中的产生式 */
-void getFromForecastAnalysisTable(char A, char a, vector<char> &s)
+/* 取出预测分析表对应的项中的产生式序号，-1表示空 */
+int getFromForecastAnalysisTable(char A, char a)
 {
     /* 根据A和a找到对应表项 */
     int i = isInN(A) - 1;
     int j = isInT(a) - 1;
-    /* 取出 */
-    s.assign(M[i][j].begin(), M[i][j].end());
+    /* a不是终结符时没有对应的列 */
+    if (j < 0)
+        return -1;
+    return M[i][j];
+}
+/* 预先求出每个产生式逆序且去掉空的右部 */
+void getReversedRights()
+{
+    rhsPool.clear();
+    rhsSpan.clear();
+    markPool.clear();
+    for (int i = 0; i < grammar.prods.size(); i++) {
+        Production &P = grammar.prods[i];
+        int begin = rhsPool.size();
+        /* 变换后的右部带有归约标记，标记和符号一起逆序入栈 */
+        if (transformed) {
+            vector<int> &R = markedRights[i];
+            for (int k = R.size() - 1; k >= 0; k--) {
+                rhsPool.push_back(R[k] < 0 ? ACTION_MARK : R[k]);
+                markPool.push_back(R[k] < 0 ? -R[k] - 1 : -1);
+            }
+            rhsSpan.push_back(pair<int, int>(begin, rhsPool.size() - begin));
+            continue;
+        }
+        for (int k = P.rigths.size() - 1; k >= 0; k--) {
+            if (P.rigths[k] != '&') { // 为空时不入栈
+                rhsPool.push_back(P.rigths[k]);
+            }
+        }
+        rhsSpan.push_back(pair<int, int>(begin, rhsPool.size() - begin));
+    }
+}
+/* 输出产生式 */
+void printProduction(int p)
+{
+    Production &P = grammar.prods[p];
+    printf("%c->", P.left);
+    for (int i = 0; i < P.rigths.size(); i++) {
+        printf("%c", P.rigths[i]);
+    }
+}
+/* 输出原文法的产生式 */
+void printSourceProduction(int p)
+{
+    Production &P = source.prods[p];
+    printf("%c->", P.left);
+    for (int i = 0; i < P.rigths.size(); i++) {
+        printf("%c", P.rigths[i]);
+    }
 }
 /* 构建预测分析表 */
 void productForecastAnalysisTable()
 {
+    for (int i = 0; i < 50; i++) {
+        for (int j = 0; j < 50; j++) {
+            M[i][j] = -1;
+        }
+    }
     /* 枚举所有产生式 */
     for (int i = 0; i < grammar.prods.size(); i++) {
         /* 假设P为 A->alpha */
@@ -262,13 +402,13 @@ void productForecastAnalysisTable()
         /* 对每个 a in FIRST(alpha) 把 A->alpha放入M[A, a]中 */
         getFirstByAlphaSet(P.rigths, FS);
         for (auto it = FS.begin(); it != FS.end(); it++) {
-            insertTOForecastAnalysisTable(P.left, *it, P);
+            insertTOForecastAnalysisTable(P.left, *it, i);
         }
         /* 如果alpha能推空，则把每个b in FOLLOW(A) 把 A->alpha放入M[A, b]中*/
         auto itt = FS.find('&');
         if (itt != FS.end()) {
             for (auto it = follow[P.left].begin(); it != follow[P.left].end(); it++) {
-                insertTOForecastAnalysisTable(P.left, *it, P);
+                insertTOForecastAnalysisTable(P.left, *it, i);
             }
         }
     }
@@ -282,8 +422,8 @@ void productForecastAnalysisTable()
     for (int i = 0; i < grammar.N.size(); i++) {
         printf("%c\t", grammar.N[i]);
         for (int j = 0; j < grammar.T.size(); j++) {
-            for(auto k = M[i][j].begin(); k != M[i][j].end(); k++) {
-                printf("%c", *k);
+            if (M[i][j] >= 0) {
+                printProduction(M[i][j]);
             }
             printf("\t\t");
         }
@@ -291,6 +431,238 @@ void productForecastAnalysisTable()
     }
 }
 /* 读入并初始化语法 */
+/* 变换过程中的产生式，右部非负为符号，负数-(p+1)为原文法第p个产生式的归约标记，空右部为空产生式。
+ * 原文法的产生式A->alpha写成A->alpha{p}，变换时标记和符号一起移动，
+ * 分析时按出栈顺序得到的标记序列就是原文法分析树的后序 */
+struct MarkedProduction {
+    char left;
+    vector<int> rigths;
+};
+
+/* 取一个没有用过的字符作为新的非终结符 */
+char newNonterminal()
+{
+    const char *candidates = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    for (const char *c = candidates; *c; c++) {
+        if (!isInN(*c) && !isInT(*c)) {
+            grammar.N.push_back(*c);
+            return *c;
+        }
+    }
+    printf("too many non-terminators\n");
+    exit(1);
+}
+
+/* 右部第一个不是归约标记的符号的下标，没有时为右部长度 */
+int leadingSymbol(vector<int> &R)
+{
+    int q = 0;
+    while (q < R.size() && R[q] < 0) {
+        q++;
+    }
+    return q;
+}
+
+/* 消除左递归：依次对每个Ai，把 Ai->Aj gamma (j<i) 中的Aj用Aj的所有右部代入，
+ * 再把直接左递归 Ai->Ai alpha | beta 改写为 Ai->beta Ai'，Ai'->alpha Ai' | 空 */
+void eliminateLeftRecursion(vector<MarkedProduction> &ps)
+{
+    int n = grammar.N.size();
+    for (int i = 0; i < n; i++) {
+        char Ai = grammar.N[i];
+        for (int j = 0; j < i; j++) {
+            char Aj = grammar.N[j];
+            vector<MarkedProduction> out;
+            for (int k = 0; k < ps.size(); k++) {
+                vector<int> &R = ps[k].rigths;
+                int q = leadingSymbol(R);
+                if (ps[k].left != Ai || q == R.size() || R[q] != Aj) {
+                    out.push_back(ps[k]);
+                    continue;
+                }
+                for (int m = 0; m < ps.size(); m++) {
+                    if (ps[m].left != Aj) {
+                        continue;
+                    }
+                    MarkedProduction P;
+                    P.left = Ai;
+                    P.rigths.assign(R.begin(), R.begin() + q);
+                    P.rigths.insert(P.rigths.end(), ps[m].rigths.begin(), ps[m].rigths.end());
+                    P.rigths.insert(P.rigths.end(), R.begin() + q + 1, R.end());
+                    out.push_back(P);
+                }
+            }
+            ps.swap(out);
+        }
+        /* 找出Ai的直接左递归产生式 */
+        bool recursive = false, hidden = false;
+        for (int k = 0; k < ps.size(); k++) {
+            vector<int> &R = ps[k].rigths;
+            int q = leadingSymbol(R);
+            if (ps[k].left == Ai && q < R.size() && R[q] == Ai) {
+                recursive = true;
+                /* Ai前面有空产生式的归约标记，无法改写成右递归 */
+                if (q > 0) {
+                    hidden = true;
+                }
+            }
+        }
+        if (!recursive) {
+            continue;
+        }
+        if (hidden) {
+            printf("cannot eliminate left recursion of %c\n", Ai);
+            continue;
+        }
+        char B = newNonterminal();
+        for (int k = 0; k < ps.size(); k++) {
+            vector<int> &R = ps[k].rigths;
+            if (ps[k].left != Ai) {
+                continue;
+            }
+            if (!R.empty() && R[0] == Ai) {
+                /* Ai->Ai alpha 改为 Ai'->alpha Ai' */
+                ps[k].left = B;
+                R.erase(R.begin());
+            }
+            R.push_back(B);
+        }
+        MarkedProduction E;
+        E.left = B;
+        ps.push_back(E);
+    }
+}
+
+/* 提取左公因子：同一非终结符的几个右部有相同的第一个符号时，
+ * 把 A->alpha beta1 | alpha beta2 改写为 A->alpha A'，A'->beta1 | beta2，alpha取最长公共前缀 */
+void leftFactor(vector<MarkedProduction> &ps)
+{
+    /* 新加入的非终结符也要处理 */
+    for (int i = 0; i < grammar.N.size(); i++) {
+        char A = grammar.N[i];
+        bool change = true;
+        while (change) {
+            change = false;
+            for (int k = 0; k < ps.size() && !change; k++) {
+                vector<int> &R = ps[k].rigths;
+                if (ps[k].left != A || R.empty()) {
+                    continue;
+                }
+                vector<int> group(1, k);
+                int len = R.size();
+                for (int m = k + 1; m < ps.size(); m++) {
+                    vector<int> &S = ps[m].rigths;
+                    if (ps[m].left != A || S.empty() || S[0] != R[0]) {
+                        continue;
+                    }
+                    group.push_back(m);
+                    int l = 0;
+                    while (l < len && l < S.size() && S[l] == R[l]) {
+                        l++;
+                    }
+                    len = l;
+                }
+                if (group.size() < 2) {
+                    continue;
+                }
+                char B = newNonterminal();
+                MarkedProduction P;
+                P.left = A;
+                P.rigths.assign(R.begin(), R.begin() + len);
+                P.rigths.push_back(B);
+                for (int g = 0; g < group.size(); g++) {
+                    MarkedProduction &Q = ps[group[g]];
+                    Q.left = B;
+                    Q.rigths.erase(Q.rigths.begin(), Q.rigths.begin() + len);
+                }
+                ps.push_back(P);
+                change = true;
+            }
+        }
+    }
+}
+
+/* 变换文法，变换后的产生式替换grammar中的产生式，原文法保存在source中 */
+void transformGrammar()
+{
+    source = grammar;
+    sourceLen.clear();
+    vector<MarkedProduction> ps;
+    for (int i = 0; i < grammar.prods.size(); i++) {
+        Production &P = grammar.prods[i];
+        MarkedProduction Q;
+        Q.left = P.left;
+        for (int k = 0; k < P.rigths.size(); k++) {
+            if (P.rigths[k] != '&') {
+                Q.rigths.push_back(P.rigths[k]);
+            }
+        }
+        sourceLen.push_back(Q.rigths.size());
+        Q.rigths.push_back(-i - 1);
+        ps.push_back(Q);
+    }
+    eliminateLeftRecursion(ps);
+    leftFactor(ps);
+    /* 按非终结符的顺序排列产生式 */
+    stable_sort(ps.begin(), ps.end(), [](const MarkedProduction &a, const MarkedProduction &b) {
+        return isInN(a.left) < isInN(b.left);
+    });
+    /* 去掉归约标记得到分析用的产生式，只有标记的右部为空 */
+    grammar.prods.clear();
+    markedRights.clear();
+    for (int i = 0; i < ps.size(); i++) {
+        Production P;
+        P.left = ps[i].left;
+        for (int k = 0; k < ps[i].rigths.size(); k++) {
+            if (ps[i].rigths[k] >= 0) {
+                P.rigths.push_back(ps[i].rigths[k]);
+            }
+        }
+        if (P.rigths.empty()) {
+            P.rigths.push_back('&');
+        }
+        grammar.prods.push_back(P);
+        markedRights.push_back(ps[i].rigths);
+    }
+    grammar.num = grammar.prods.size();
+    printf("transformed grammar:\n");
+    for (int i = 0; i < grammar.prods.size(); i++) {
+        printProduction(i);
+        printf("\n");
+    }
+}
+
+/* 由归约标记的后序序列建立原文法的分析树，按先序输出即为原文法的最左推导 */
+void printSourceDerivation()
+{
+    vector< vector<int> > children(reduced.size());
+    vector<int> nodes;
+    for (int i = 0; i < reduced.size(); i++) {
+        Production &P = source.prods[reduced[i]];
+        /* 右部的非终结符各对应一个已经建好的子树 */
+        int k = 0;
+        for (int j = 0; j < P.rigths.size(); j++) {
+            if (isInN(P.rigths[j])) {
+                k++;
+            }
+        }
+        children[i].assign(nodes.end() - k, nodes.end());
+        nodes.resize(nodes.size() - k);
+        nodes.push_back(i);
+    }
+    vector<int> todo(nodes.rbegin(), nodes.rend());
+    while (!todo.empty()) {
+        int x = todo.back();
+        todo.pop_back();
+        printSourceProduction(reduced[x]);
+        printf("\n");
+        todo.insert(todo.end(), children[x].rbegin(), children[x].rend());
+    }
+}
+
+/* 语料模式用到分析程序，定义在process()之后 */
+bool parseCorpusLine(const string &s);
+
 void initGrammar()
 {
     printf("Please enter the num of production:\n");
@@ -319,69 +691,209 @@ void initGrammar()
         grammar.T.push_back(ch);
         cin >> ch;
     }
+    /* 删去无用和不可达的符号及产生式 */
+    reduceGrammar(grammar);
     /* 把$当作终结符 */
     grammar.T.push_back('$');
+    if (transformed) {
+        transformGrammar();
+    }
     /* 求FIRST集和FOLLOW集 */
     getFirstSet();
+    getSuffixFirstSet();
     getFollowSet();
 
     /* 生成预测分析表 */
     productForecastAnalysisTable();
+    getReversedRights();
+    if (!latencyCorpus.empty()) {
+        bool e = eval;
+        eval = false;
+        quiet = true;
+        measureLatency(latencyCorpus, latencyJson, parseCorpusLine);
+        quiet = false;
+        eval = e;
+    }
 
     /* 读入待分析串并初始化分析栈 */
     printf("Please enter the String to be analyzed:\n");
     cin >> str;
+    if (eval) {
+        /* 变换文法时动作属于原文法的产生式 */
+        values.bind(transformed ? source.prods : grammar.prods);
+        values.lexNumbers(str);
+    }
     str += '$';
-    ST.push('$');
-    ST.push(grammar.N[0]);
+    /* 每次展开最多压入最长右部的符号，按输入长度预先分配分析栈 */
+    int maxLen = 1;
+    for (int i = 0; i < rhsSpan.size(); i++) {
+        maxLen = max(maxLen, rhsSpan[i].second + (eval ? 1 : 0));
+    }
+    ST.resize((str.size() + 1) * maxLen + grammar.N.size() * maxLen + 2);
+    MK.resize(eval || transformed ? ST.size() : 0);
+    top = -1;
+    ST[++top] = '$';
+    ST[++top] = grammar.N[0];
 }
 /* 分析程序 */
-void process()
+/* 分析程序，接受时返回true，quiet时遇到错误返回false */
+bool process()
 {
     /* 指向当前字符 */
     int ip = 0;
     /* 栈顶符号X， 和当前输入符号a */
     char X, a;
-    printf("The answer:\n");
+    if (!quiet) {
+        printf("The answer:\n");
+    }
     do{
-        X = ST.top();
+        X = ST[top];
         a = str[ip];
+        /* 右部已经全部匹配，执行语义动作 */
+        if (X == ACTION_MARK) {
+            int p = MK[top--];
+            if (transformed) {
+                /* 变换后的标记对应原文法的产生式 */
+                reduced.push_back(p);
+                if (eval) {
+                    values.reduce(p, sourceLen[p]);
+                }
+            } else {
+                values.reduce(p, rhsSpan[p].second);
+            }
+            continue;
+        }
         /* 如果是终结符或者$ */
         if (isInT(X)) {
             /* 如果栈顶符号和当前符号匹配，出栈，指针前移 */
             if (X == a) {
-                ST.pop();
+                TRACE_EVENT(TRACE_MATCH, top, ip, X);
+                if (eval && X != '$') {
+                    values.shift(ip);
+                }
+                top--;
                 ip = ip + 1;
             } else { /* 不匹配报错 */
+                TRACE_EVENT(TRACE_MISMATCH, top, ip, X);
+                if (quiet) {
+                    return false;
+                }
                 printf("error1\n");
+                /* 第一次出错时输出跟踪 */
+                if (trace) {
+                    printTrace();
+                    trace = false;
+                }
             }
         } else {    //非终结符
-            vector<char> s;
             /* 取出对应预测分析表的项 */
-            getFromForecastAnalysisTable(X, a, s);
-            /* 预测分析表项中有元素 */
-            if (!s.empty()) {
-                /* 弹栈并将右部符号串逆序入栈 */
-                ST.pop();
-                for (int i = s.size() - 1; i >= 3; i--) {
-                    if (s[i] != '&') { // 为空时不入栈
-                        ST.push(s[i]);
+            int p = getFromForecastAnalysisTable(X, a);
+            /* 预测分析表项中有产生式 */
+            if (p >= 0) {
+                TRACE_EVENT(TRACE_EXPAND, top, ip, p);
+                /* 弹栈并将预先逆序好的右部符号串入栈 */
+                int len = rhsSpan[p].second;
+                /* 超出预先分配的空间时才扩充 */
+                if (top + len + 1 >= ST.size()) {
+                    ST.resize(ST.size() * 2 + len + 1);
+                    if (eval || transformed) {
+                        MK.resize(ST.size());
                     }
                 }
-                /* 输出产生式 */
-                for (int i = 0; i < s.size(); i++) {
-                        printf("%c", s[i]);
+                const char *rhs = rhsPool.data() + rhsSpan[p].first;
+                top--;
+                /* 动作标记在右部下面，右部全部匹配后才出栈 */
+                if (eval && !transformed) {
+                    ST[++top] = ACTION_MARK;
+                    MK[top] = p;
+                }
+                for (int i = 0; i < len; i++) {
+                    ST[++top] = rhs[i];
+                }
+                /* 变换后的右部中带有归约标记 */
+                if (transformed) {
+                    const int *marks = markPool.data() + rhsSpan[p].first;
+                    for (int i = 0; i < len; i++) {
+                        MK[top - len + 1 + i] = marks[i];
+                    }
+                } else if (!quiet) {
+                    /* 输出产生式 */
+                    printProduction(p);
+                    printf("\n");
                 }
-                printf("\n");
             } else { // 空，报错
+                TRACE_EVENT(TRACE_MISMATCH, top, ip, X);
+                if (quiet) {
+                    return false;
+                }
                 printf("error2\n");
+                if (trace) {
+                    printTrace();
+                    trace = false;
+                }
             }
         }
     } while (X != '$');
+    TRACE_EVENT(TRACE_ACCEPT, top, ip, 0);
+    if (quiet) {
+        return true;
+    }
+    /* 输出换回原文法的最左推导 */
+    if (transformed) {
+        printSourceDerivation();
+    }
+    if (eval && !values.empty()) {
+        printf("value: %g\n", values.top());
+    }
+    if (trace) {
+        printTrace();
+    }
+    return true;
+}
+
+/* 清空分析栈，只留下$和开始符号 */
+void resetStack()
+{
+    if (ST.size() < 64) {
+        ST.resize(64);
+        MK.resize(eval || transformed ? ST.size() : 0);
+    }
+    top = -1;
+    ST[++top] = '$';
+    ST[++top] = grammar.N[0];
+    reduced.clear();
 }
 
-int main()
+/* 不输出地分析语料中的一个串，--latency计时用 */
+bool parseCorpusLine(const string &s)
 {
+    str = s;
+    resetStack();
+    return process();
+}
+
+int main(int argc, char *argv[])
+{
+    /* --eval 输入串中可以写数字，分析的同时执行语义动作计算值 */
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--eval") {
+            eval = true;
+            values.registerArithmetic();
+        }
+        /* --transform 消除左递归、提取左公因子后再生成预测分析表 */
+        if (string(argv[i]) == "--transform") {
+            transformed = true;
+        }
+        /* --latency CORPUS JSON 把语料中每个串的分析延迟写成JSON，--trace 输出编译时打开的分析跟踪 */
+        if (string(argv[i]) == "--latency" && i + 2 < argc) {
+            latencyCorpus = argv[i + 1];
+            latencyJson = argv[i + 2];
+            i += 2;
+        }
+        if (string(argv[i]) == "--trace") {
+            trace = true;
+        }
+    }
     initGrammar();
     process();
     return 0;
@@ -1,4 +1,6 @@
 #include <cstdio>
+#include <cstdlib>
+#include <cctype>
 #include <vector>
 #include <string>
 #include <iostream>
@@ -6,6 +8,15 @@
 #include <set>
 #include <stack>
 #include <queue>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <chrono>
+#include "glr.h"
+#include "lrtable.h"
+#include "semantic.h"
+#include "simplify.h"
+#include "trace.h"
 using namespace std;
 
 /* 产生式结构体，左部符号和右部符号串 */
@@ -28,24 +39,30 @@ struct Production {
 
 /* LR1项目 */
 struct LR1Item {
-    Production p;
+    /* 产生式序号 */
+    int prod;
     /* 点的位置 */
     int location;
     /* 向前看符号 */
     char next;
 };
 
-/* LR1项目集 */
+/* LR1项目集，其项目保存在项目池arena的[begin, end)区间中 */
 struct LR1Items {
-    vector<LR1Item> items;
+    int begin;
+    int end;
 };
 
+/* 项目池，一次构建中所有项目集的项目都从这里分配。
+ * 转移得到的候选项目集直接在池的末尾构造，若与已有项目集重复则回退 */
+vector<LR1Item> arena;
+
 /* LR1项目集规范族 */
 struct CanonicalCollection {
     /* 项目集集合 */
     vector<LR1Items> items;
     /* 保存DFA的图，first为转移到的状态序号，second是经什么转移 */
-    vector< pair<int, char> > g[100];
+    vector< pair<int, char> > g[MAX_STATES];
 }CC;
 
 /* 文法结构体 */
@@ -60,18 +77,55 @@ struct Grammar {
 map<char, set<char> > first;
 map<char, set<char> > follow;
 
+/* 产生式右部各个后缀的FIRST集(不含空，按字符排好序)和能否推空，
+ * suffixFirst[i][j]为第i个产生式右部从第j个符号开始的后缀的FIRST集 */
+vector< vector< vector<char> > > suffixFirst;
+vector< vector<bool> > suffixNullable;
+
 /* DFA队列， 用于存储待转移的有效项目集 */
-queue< pair<LR1Items, int> > Q;
+queue<int> Q; // 保存状态序号
+
+/* 分析表，生成后按需优化：默认规约、单产生式(A->B)规约的消除、移进-规约合并 */
+LRTable table;
+bool optimize = false;
+/* 分析步数，以及优化省去的步数 */
+int steps, savedSteps;
 
-/* action表和goto表 */
-pair<int, int> action[100][100]; // first表示分析动作，0->ACC 1->S 2->R second表示转移状态或者产生式序号
-int goton[100][100];
+/* 最小LR1模式：构建时合并弱相容的同核心状态 */
+bool minimal = false;
+/* 懒惰模式：不预先构建整个DFA，分析时第一次进入某个状态才构建它的转移和分析表的行 */
+bool lazy = false;
+/* built[i]表示状态i的转移和分析表的行是否已经构建 */
+bool built[MAX_STATES];
 
 /* 待分析串 */
 string str;
+
+/* --memory-budget 构建规范LR1时项目、状态和DFA的图最多占用的字节数，0为不限制；
+ * 超出时放弃规范LR1，改为按LR0核心合并状态(LALR1)构建 */
+long long memoryBudget = 0;
+/* 最小LR1模式下只要核心相同就合并状态，即LALR1 */
+bool lalr = false;
+
+/* --profile 用训练语料统计状态、终结符、非终结符和产生式的使用次数，按次数重新编号，
+ * 再比较重新编号前后分析留出语料的速度。profiling时process()计数，quiet时process()不输出 */
+string trainFile, heldoutFile;
+bool profiling = false, quiet = false;
+vector<long long> stateHits, termHits, nontermHits, prodHits;
+
+/* --latency CORPUS JSON 逐个分析语料中的串，把每个串的分析延迟的分位数和直方图写到JSON文件 */
+string latencyCorpus, latencyJson;
+
+/* --trace 在接受或第一次出错时输出trace.h记录的分析事件 */
+bool trace = false;
 /* 分析栈 */
 stack< pair<int, char> > ST; // first是state，second 是symble
 
+/* 语义动作模式：输入串中的数字当作终结符n，分析的同时计算值 */
+bool eval = false;
+/* 语义动作和值栈 */
+ValueStack values;
+
 /* 判断ch是否是终结符 */
 int isInT(char ch)
 {
@@ -200,12 +254,53 @@ void getFirstByAlphaSet(vector<char> &alpha, set<char> &FS)
     }
 }
 
-/* 判断是LR1项目t否在有效项目集I中 */
-bool isInLR1Items(LR1Items &I, LR1Item &t)
+/* 预先求出每个产生式右部每个后缀的FIRST集和能否推空 */
+void getSuffixFirstSet()
+{
+    suffixFirst.assign(grammar.prods.size(), vector< vector<char> >());
+    suffixNullable.assign(grammar.prods.size(), vector<bool>());
+    for (int i = 0; i < grammar.prods.size(); i++) {
+        Production &P = grammar.prods[i];
+        int n = P.rigths.size();
+        suffixFirst[i].assign(n + 1, vector<char>());
+        suffixNullable[i].assign(n + 1, false);
+        /* 空后缀能推空 */
+        suffixNullable[i][n] = true;
+        /* 从后往前求，后缀j的FIRST集为FIRST(X_j)，若X_j能推空则再并上后缀j+1的FIRST集 */
+        for (int j = n - 1; j >= 0; j--) {
+            char X = P.rigths[j];
+            set<char> FS;
+            bool nullable = false;
+            if (X == '&') {
+                nullable = true;
+            } else if (isInT(X)) {
+                FS.insert(X);
+            } else {
+                set<char> &FX = first[X];
+                for (auto it = FX.begin(); it != FX.end(); it++) {
+                    if (*it == '&') {
+                        nullable = true;
+                    } else {
+                        FS.insert(*it);
+                    }
+                }
+            }
+            if (nullable) {
+                FS.insert(suffixFirst[i][j + 1].begin(), suffixFirst[i][j + 1].end());
+                nullable = suffixNullable[i][j + 1];
+            }
+            suffixFirst[i][j].assign(FS.begin(), FS.end());
+            suffixNullable[i][j] = nullable;
+        }
+    }
+}
+
+/* 判断LR1项目t是否在项目池的[begin, end)区间中 */
+bool isInLR1Items(int begin, int end, LR1Item &t)
 {
-    for (auto it = I.items.begin(); it != I.items.end(); it++) {
-        LR1Item &item = *it;
-        if (item.p == t.p && item.location == t.location && item.next == t.next)
+    for (int i = begin; i < end; i++) {
+        LR1Item &item = arena[i];
+        if (item.prod == t.prod && item.location == t.location && item.next == t.next)
             return true;
     }
     return false;
@@ -214,83 +309,193 @@ bool isInLR1Items(LR1Items &I, LR1Item &t)
 /* 打印某个项目集 */
 void printLR1Items(LR1Items &I)
 {
-    for (auto it = I.items.begin(); it != I.items.end(); it++) {
-        LR1Item &L = *it;
-        printf("%c->", L.p.left);
-        for (int i = 0; i < L.p.rigths.size(); i++) {
+    for (int k = I.begin; k < I.end; k++) {
+        LR1Item &L = arena[k];
+        Production &P = grammar.prods[L.prod];
+        printf("%c->", P.left);
+        for (int i = 0; i < P.rigths.size(); i++) {
             if (L.location == i)
                 printf(".");
-            printf("%c", L.p.rigths[i]);
+            printf("%c", P.rigths[i]);
         }
-        if (L.location == L.p.rigths.size())
+        if (L.location == P.rigths.size())
             printf(".");
         printf(",%c   ", L.next);
     }
     printf("\n");
 }
 
-/* 求I的闭包 */
-void closure(LR1Items &I)
+/* 位集合，用来表示产生式集合和终结符集合(以在grammar.T中的下标为序号) */
+typedef vector<unsigned long long> Bits;
+bool testBit(const Bits &b, int i)
 {
-    bool change =  true;
-    while (change) {
-        change = false;
-        LR1Items J;
-        /* 枚举每个项目 */
-        J.items.assign(I.items.begin(), I.items.end());
-        for (auto it = J.items.begin(); it != J.items.end(); it++) {
-            LR1Item &L = *it;
-            /* 非规约项目 */
-            if (L.location < L.p.rigths.size()) {
-                char B = L.p.rigths[L.location];
-                if (isInN(B)) {
-                    /* 把符合条件的LR1项目加入闭包中 */
-                   
-                    /* 先求出B后面的FIRST集 */
-                    set<char> FS;
-                    vector<char> alpha;
-                    alpha.assign(L.p.rigths.begin() + L.location + 1, L.p.rigths.end());
-                    alpha.push_back(L.next);
-                    getFirstByAlphaSet(alpha, FS);
-
-                    for (int i = 0; i < grammar.prods.size(); i++) {
-                        Production &P = grammar.prods[i];
-                        if (P.left == B) {
-                            /* 枚举每个b in B后面的FIRST集 */
-                            for (auto it = FS.begin(); it != FS.end(); it++) {
-                                char b = *it;
-                                LR1Item t;
-                                t.location = 0;
-                                t.next = b;
-                                t.p.left = P.left;
-                                t.p.rigths.assign(P.rigths.begin(), P.rigths.end());
-                                if (!isInLR1Items(I, t)) {
-                                    /* 标记改变 */
-                                    change = true;
-                                    I.items.push_back(t);
-                                } 
-                            }
-                        } 
+    return (b[i >> 6] >> (i & 63)) & 1;
+}
+void setBit(Bits &b, int i)
+{
+    b[i >> 6] |= 1ULL << (i & 63);
+}
+/* a |= b，返回a是否发生变化 */
+bool orBits(Bits &a, const Bits &b)
+{
+    bool change = false;
+    for (int w = 0; w < a.size(); w++) {
+        unsigned long long x = a[w] | b[w];
+        if (x != a[w]) {
+            a[w] = x;
+            change = true;
+        }
+    }
+    return change;
+}
+
+/* 非终结符B的LR1闭包模板。项目[A->α.Bβ, a]的闭包中产生式p的项目的向前看符号为
+ * spont[p]，若prop中p对应位为真，再并上FIRST(βa) */
+struct ClosureTemplate {
+    /* 闭包中出现的产生式 */
+    Bits prods;
+    /* 自发生成的向前看符号 */
+    vector<Bits> spont;
+    /* B的向前看符号是否传播到该产生式 */
+    Bits prop;
+};
+/* closureOf[j]为第j个非终结符的闭包模板，与具体状态无关，求闭包时直接合并 */
+vector<ClosureTemplate> closureOf;
+
+/* 预先求出每个非终结符的闭包模板 */
+void getClosureTemplates()
+{
+    int pwords = (grammar.prods.size() + 63) / 64;
+    int twords = (grammar.T.size() + 63) / 64;
+    closureOf.assign(grammar.N.size(), ClosureTemplate());
+    for (int b = 0; b < grammar.N.size(); b++) {
+        ClosureTemplate &C = closureOf[b];
+        C.prods.assign(pwords, 0);
+        C.prop.assign(pwords, 0);
+        C.spont.assign(grammar.prods.size(), Bits(twords, 0));
+        /* B的产生式直接继承B的向前看符号 */
+        for (int i = 0; i < grammar.prods.size(); i++) {
+            if (grammar.prods[i].left == grammar.N[b]) {
+                setBit(C.prods, i);
+                setBit(C.prop, i);
+            }
+        }
+        /* 当模板发生变化时循环 */
+        bool change = true;
+        while (change) {
+            change = false;
+            /* 枚举模板中每个形如C->.Dδ的项目 */
+            for (int i = 0; i < grammar.prods.size(); i++) {
+                if (!testBit(C.prods, i))
+                    continue;
+                char D = grammar.prods[i].rigths[0];
+                if (!isInN(D))
+                    continue;
+                /* FIRST(δ)的符号自发生成，δ能推空时再继承该项目的向前看符号 */
+                Bits FD(twords, 0);
+                vector<char> &FS = suffixFirst[i][1];
+                for (auto it = FS.begin(); it != FS.end(); it++) {
+                    setBit(FD, isInT(*it) - 1);
+                }
+                bool nullable = suffixNullable[i][1];
+                for (int q = 0; q < grammar.prods.size(); q++) {
+                    if (grammar.prods[q].left != D)
+                        continue;
+                    if (!testBit(C.prods, q)) {
+                        setBit(C.prods, q);
+                        change = true;
+                    }
+                    if (orBits(C.spont[q], FD))
+                        change = true;
+                    if (nullable) {
+                        if (orBits(C.spont[q], C.spont[i]))
+                            change = true;
+                        if (testBit(C.prop, i) && !testBit(C.prop, q)) {
+                            setBit(C.prop, q);
+                            change = true;
+                        }
                     }
                 }
             }
         }
     }
 }
-/* 判断是否在项目集规范族中，若在返回序号 */
-int isInCanonicalCollection(LR1Items &I)
+
+/* 求项目池中从begin开始到末尾的项目集的闭包，新项目直接追加到池末尾 */
+void closure(int begin)
 {
+    /* 每个产生式的项目的向前看符号、出现的产生式、FIRST(βa)，重复使用 */
+    static vector<Bits> acc;
+    static Bits used;
+    static Bits la;
+    int twords = (grammar.T.size() + 63) / 64;
+    acc.resize(grammar.prods.size());
+    for (int i = 0; i < acc.size(); i++) {
+        acc[i].assign(twords, 0);
+    }
+    used.assign((grammar.prods.size() + 63) / 64, 0);
+    int end = arena.size();
+    /* 合并每个点后面是非终结符的项目对应的闭包模板 */
+    for (int k = begin; k < end; k++) {
+        LR1Item &L = arena[k];
+        Production &LP = grammar.prods[L.prod];
+        /* 非规约项目 */
+        if (L.location >= LP.rigths.size())
+            continue;
+        int b = isInN(LP.rigths[L.location]) - 1;
+        if (b < 0)
+            continue;
+        /* 取出预先求好的B后面的FIRST集，后缀能推空时才加入L的向前看符号 */
+        la.assign(twords, 0);
+        vector<char> &FB = suffixFirst[L.prod][L.location + 1];
+        for (auto it = FB.begin(); it != FB.end(); it++) {
+            setBit(la, isInT(*it) - 1);
+        }
+        if (suffixNullable[L.prod][L.location + 1]) {
+            setBit(la, isInT(L.next) - 1);
+        }
+        ClosureTemplate &C = closureOf[b];
+        orBits(used, C.prods);
+        for (int i = 0; i < grammar.prods.size(); i++) {
+            if (!testBit(C.prods, i))
+                continue;
+            orBits(acc[i], C.spont[i]);
+            if (testBit(C.prop, i))
+                orBits(acc[i], la);
+        }
+    }
+    /* 把符合条件的LR1项目加入闭包中 */
+    for (int i = 0; i < grammar.prods.size(); i++) {
+        if (!testBit(used, i))
+            continue;
+        for (int j = 0; j < grammar.T.size(); j++) {
+            if (!testBit(acc[i], j))
+                continue;
+            LR1Item t;
+            t.prod = i;
+            t.location = 0;
+            t.next = grammar.T[j];
+            /* 只有初始项目集的核心中可能已有点在最左边的项目 */
+            if (!isInLR1Items(begin, end, t)) {
+                arena.push_back(t);
+            }
+        }
+    }
+}
+/* 判断从begin开始到池末尾的项目集是否在项目集规范族中，若在返回序号 */
+int isInCanonicalCollection(int begin)
+{
+    int size = arena.size() - begin;
     for (int i = 0; i < CC.items.size(); i++) {
         LR1Items &J = CC.items[i];
         bool flag = true;
-        if (J.items.size() != I.items.size()) {
+        if (J.end - J.begin != size) {
             flag = false;
             continue;
         }
         /* 每个项目都在该项目集中，则认为这个两个项目集相等 */
-        for (auto it = I.items.begin(); it != I.items.end(); it++) {
-            LR1Item &t = *it;
-            if (!isInLR1Items(J, t)) {
+        for (int k = begin; k < arena.size(); k++) {
+            if (!isInLR1Items(J.begin, J.end, arena[k])) {
                 flag = false;
                 break;
             }
@@ -302,95 +507,410 @@ int isInCanonicalCollection(LR1Items &I)
     return 0;
 }
 
-/* 转移函数，I为当前的项目集，J为转移后的项目集, 经X转移 */
-void go(LR1Items &I, char X, LR1Items &J)
+/* 把项目池末尾从begin开始的候选项目集加入规范族，返回其序号，已存在时回收其空间 */
+int addLR1Items(int begin)
+{
+    int idx = isInCanonicalCollection(begin);
+    if (idx > 0) {
+        arena.resize(begin);
+        return idx - 1;
+    }
+    /* 状态数已满，不能再加入 */
+    if (CC.items.size() >= MAX_STATES) {
+        arena.resize(begin);
+        return -1;
+    }
+    LR1Items I;
+    I.begin = begin;
+    I.end = arena.size();
+    CC.items.push_back(I);
+    idx = CC.items.size() - 1;
+    /* 把新加入的有效项目集加入待扩展队列中 */
+    Q.push(idx);
+    return idx;
+}
+
+/* 按点后面的符号比较，用于分桶 */
+bool lessBySymbol(const pair<int, int> &a, const pair<int, int> &b)
+{
+    return a.first < b.first;
+}
+
+/* 把项目池[begin, end)中的非规约项目按点后面的符号分桶，
+ * moves的first为符号序号(终结符在前，非终结符在后)，second为项目在池中的下标 */
+void bucketItems(int begin, int end, vector< pair<int, int> > &moves)
 {
-    for (auto it = I.items.begin(); it != I.items.end(); it++) {
-        LR1Item &L = *it;
+    moves.clear();
+    int nt = grammar.T.size();
+    for (int k = begin; k < end; k++) {
+        LR1Item &L = arena[k];
+        Production &P = grammar.prods[L.prod];
         /* 非规约项目 */
-        if (L.location < L.p.rigths.size()) {
-            char B = L.p.rigths[L.location];
-            /* 如果点后面是非终结符，且非终结符为X，点位置加1, 加入到转移项目集中*/
-            if (B == X) {
-                LR1Item t;
-                t.location = L.location + 1;
-                t.next = L.next;
-                t.p.left = L.p.left;
-                t.p.rigths.assign(L.p.rigths.begin(), L.p.rigths.end());
-                J.items.push_back(t);
+        if (L.location < P.rigths.size()) {
+            char X = P.rigths[L.location];
+            int j = isInT(X);
+            if (j > 0) {
+                moves.push_back(pair<int, int>(j - 1, k));
+            } else if ((j = isInN(X)) > 0) {
+                moves.push_back(pair<int, int>(nt + j - 1, k));
             }
         }
     }
-    /* 若J中有项目，则求其闭包 */
-    if (J.items.size() > 0) {
-        closure(J);
+    /* 同一个桶内保持项目原来的顺序，使状态编号与逐个符号求转移时一致 */
+    stable_sort(moves.begin(), moves.end(), lessBySymbol);
+}
+
+/* 转移函数，扫描一遍状态sidx中的项目，按点后面的符号分桶，
+ * 只对非空的桶构造转移后的项目集(追加到项目池末尾)并加入DFA的边。超出状态数上限时返回false */
+bool go(int sidx)
+{
+    /* 分桶结果，重复使用 */
+    static vector< pair<int, int> > moves;
+    int nt = grammar.T.size();
+    bucketItems(CC.items[sidx].begin, CC.items[sidx].end, moves);
+    int m = 0;
+    while (m < moves.size()) {
+        int sym = moves[m].first;
+        int begin = arena.size();
+        /* 点位置加1, 加入到转移项目集中 */
+        for (; m < moves.size() && moves[m].first == sym; m++) {
+            /* 追加项目可能使池重新分配，这里拷贝一份 */
+            LR1Item L = arena[moves[m].second];
+            L.location = L.location + 1;
+            arena.push_back(L);
+        }
+        closure(begin);
+        /* 查找是否已经在有效项目集族里，不在则加入 */
+        int idx = addLR1Items(begin);
+        if (idx < 0)
+            return false;
+        /* 从原状态到转移状态加一条边，边上的值为转移符号 */
+        char X = sym < nt ? grammar.T[sym] : grammar.N[sym - nt];
+        CC.g[sidx].push_back(pair<char, int>(X, idx));
     }
+    return true;
 }
 
-/* 构建DFA和项目集规范族 */
-void DFA()
+/* 构建初始项目集，DFA()和懒惰模式共用 */
+void initDFA()
 {
+    /* 每次构建使用一个新的项目池，预先分配好空间 */
+    arena.clear();
+    arena.reserve(1024);
+    /* 先求出每个非终结符的闭包模板 */
+    getClosureTemplates();
     /* 构建初始项目集 */
     LR1Item t;
+    t.prod = 0;
     t.location = 0;
     t.next = '$';
-    t.p.left = grammar.prods[0].left;
-    t.p.rigths.assign(grammar.prods[0].rigths.begin(), grammar.prods[0].rigths.end());
-    LR1Items I;
-    I.items.push_back(t);
-    closure(I);
+    arena.push_back(t);
+    closure(0);
     /* 加入初始有效项目集 */
-    CC.items.push_back(I);
-    /* 把新加入的有效项目集加入待扩展队列中 */
-    Q.push(pair<LR1Items, int>(I, 0));
+    addLR1Items(0);
+}
+
+/* 构建过程中项目池、状态和DFA的图占用的字节数，容器按已分配的容量计算 */
+long long constructionBytes()
+{
+    long long bytes = arena.capacity() * sizeof(LR1Item) + CC.items.capacity() * sizeof(LR1Items) + sizeof(CC.g);
+    for (int i = 0; i < CC.items.size(); i++) {
+        bytes += CC.g[i].capacity() * sizeof(CC.g[i][0]);
+    }
+    return bytes;
+}
+
+/* 构建DFA和项目集规范族，超出状态数上限或者设置了内存预算时超出预算即停止，返回是否构建完成 */
+bool DFA()
+{
+    initDFA();
     while (!Q.empty()) {
-        LR1Items &S = Q.front().first;
-        int sidx = Q.front().second;
-        /* 遍历每个终结符 */
-        for (int i = 0; i  < grammar.T.size(); i++) {
-            LR1Items D;
-            go(S, grammar.T[i], D);
-            int idx;
-            /* 若不为空 */
-            if (D.items.size() > 0) {
-                /* 查找是否已经在有效项目集族里 */
-                idx = isInCanonicalCollection(D); 
-                if (idx > 0) {
-                    idx = idx - 1;
-                } else {
-                    idx = CC.items.size();
-                    CC.items.push_back(D);
-                    /* 把新加入的有效项目集加入待扩展队列中 */
-                    Q.push(pair<LR1Items, int>(D, idx));
-                }
-                /* 从原状态到转移状态加一条边，边上的值为转移符号 */
-                CC.g[sidx].push_back(pair<char, int>(grammar.T[i], idx));
+        int sidx = Q.front();
+        /* 当前状态扩展完毕，移除队列*/
+        Q.pop();
+        /* 一次扫描求出所有非空转移 */
+        if (!go(sidx)) {
+            printf("canonical LR1 needs more than %d states\n", MAX_STATES);
+            return false;
+        }
+        if (memoryBudget > 0 && constructionBytes() > memoryBudget) {
+            printf("memory budget of %lld bytes exceeded after %d states (%lld bytes)\n", memoryBudget,
+                   (int)CC.items.size(), constructionBytes());
+            return false;
+        }
+    }
+    return true;
+}
+
+/* 清空项目集规范族，用于重新构建 */
+void resetDFA()
+{
+    CC.items.clear();
+    for (int i = 0; i < MAX_STATES; i++) {
+        CC.g[i].clear();
+    }
+    while (!Q.empty()) {
+        Q.pop();
+    }
+}
+
+/* 最小LR1模式(Pager弱相容合并)下的状态，只保存核心项目 */
+struct MinimalState {
+    /* 核心项目(产生式序号, 点的位置)，按序排好 */
+    vector< pair<int, int> > core;
+    /* 每个核心项目的向前看符号集合(终结符序号) */
+    vector<Bits> la;
+    /* 出边，first为转移符号，second为转移到的状态 */
+    vector< pair<char, int> > g;
+};
+vector<MinimalState> MS;
+
+/* 判断两个位集合是否有交集 */
+bool intersects(const Bits &a, const Bits &b)
+{
+    for (int w = 0; w < a.size(); w++) {
+        if (a[w] & b[w])
+            return true;
+    }
+    return false;
+}
+
+/* Pager弱相容：对任意两个核心项目i、j，若合并后i、j的向前看符号可能相交，
+ * 则要求在合并前的某一个状态中它们就已经相交，这样合并不会引入新的规约-规约冲突 */
+bool weaklyCompatible(MinimalState &A, vector<Bits> &la)
+{
+    for (int i = 0; i < la.size(); i++) {
+        for (int j = i + 1; j < la.size(); j++) {
+            if (!intersects(A.la[i], la[j]) && !intersects(A.la[j], la[i]))
+                continue;
+            if (intersects(A.la[i], A.la[j]) || intersects(la[i], la[j]))
+                continue;
+            return false;
+        }
+    }
+    return true;
+}
+
+/* 把最小LR1状态s的核心项目追加到项目池末尾并求闭包，返回起始位置 */
+int expandKernel(int s)
+{
+    int begin = arena.size();
+    MinimalState &S = MS[s];
+    for (int i = 0; i < S.core.size(); i++) {
+        for (int t = 0; t < grammar.T.size(); t++) {
+            if (!testBit(S.la[i], t))
+                continue;
+            LR1Item L;
+            L.prod = S.core[i].first;
+            L.location = S.core[i].second;
+            L.next = grammar.T[t];
+            arena.push_back(L);
+        }
+    }
+    closure(begin);
+    return begin;
+}
+
+/* 查找核心项目相同且弱相容的状态，合并向前看符号，找不到则新建状态。
+ * 向前看符号发生变化的状态要重新求转移，放入work队列 */
+int addMinimalState(vector< pair<int, int> > &core, vector<Bits> &la,
+                    queue<int> &work, vector<bool> &inWork)
+{
+    for (int s = 0; s < MS.size(); s++) {
+        MinimalState &A = MS[s];
+        if (A.core != core || (!lalr && !weaklyCompatible(A, la)))
+            continue;
+        bool change = false;
+        for (int i = 0; i < la.size(); i++) {
+            if (orBits(A.la[i], la[i]))
+                change = true;
+        }
+        if (change && !inWork[s]) {
+            inWork[s] = true;
+            work.push(s);
+        }
+        return s;
+    }
+    MinimalState A;
+    A.core = core;
+    A.la = la;
+    MS.push_back(A);
+    inWork.push_back(true);
+    work.push(MS.size() - 1);
+    return MS.size() - 1;
+}
+
+/* 最小LR1的转移函数，重新求状态s的所有出边 */
+void goMinimal(int s, queue<int> &work, vector<bool> &inWork)
+{
+    vector< pair<int, int> > moves;
+    int nt = grammar.T.size();
+    int twords = (grammar.T.size() + 63) / 64;
+    int begin = expandKernel(s);
+    bucketItems(begin, arena.size(), moves);
+    MS[s].g.clear();
+    int m = 0;
+    while (m < moves.size()) {
+        int sym = moves[m].first;
+        /* 点位置加1，相同核心项目的向前看符号合并到一起 */
+        vector< pair<int, int> > core;
+        vector<Bits> la;
+        for (; m < moves.size() && moves[m].first == sym; m++) {
+            LR1Item &L = arena[moves[m].second];
+            pair<int, int> c(L.prod, L.location + 1);
+            int i = lower_bound(core.begin(), core.end(), c) - core.begin();
+            if (i == core.size() || core[i] != c) {
+                core.insert(core.begin() + i, c);
+                la.insert(la.begin() + i, Bits(twords, 0));
             }
+            setBit(la[i], isInT(L.next) - 1);
         }
-        /* 遍历每个非终结符 */
-        for (int i = 0; i  < grammar.N.size(); i++) {
-            LR1Items D;
-            go(S, grammar.N[i], D);
-            int idx;
-            if (D.items.size() > 0) {
-                /* 查找是否已经在有效项目集族里 */
-                idx = isInCanonicalCollection(D); 
-                if (idx != 0) {
-                    idx = idx - 1;
-                } else {
-                    idx = CC.items.size();
-                    CC.items.push_back(D);
-                    /* 把新加入的有效项目集加入待扩展队列中 */
-                    Q.push(pair<LR1Items, int>(D, idx));
-                }
-                /* 从原状态到转移状态加一条边，边上的值为转移符号 */
-                CC.g[sidx].push_back(pair<char, int>(grammar.N[i], idx));
+        int t = addMinimalState(core, la, work, inWork);
+        char X = sym < nt ? grammar.T[sym] : grammar.N[sym - nt];
+        MS[s].g.push_back(pair<char, int>(X, t));
+    }
+    /* 闭包只是临时求的，用完即回收 */
+    arena.resize(begin);
+}
+
+/* 构建最小LR1的DFA，结果同样放在项目集规范族CC中，超出状态数上限时返回false */
+bool minimalDFA()
+{
+    arena.clear();
+    arena.reserve(1024);
+    getClosureTemplates();
+    MS.clear();
+    /* 初始状态 */
+    queue<int> work;
+    vector<bool> inWork;
+    vector< pair<int, int> > core(1, pair<int, int>(0, 0));
+    vector<Bits> la(1, Bits((grammar.T.size() + 63) / 64, 0));
+    setBit(la[0], grammar.T.size() - 1);
+    addMinimalState(core, la, work, inWork);
+    /* 直到没有状态的向前看符号再发生变化 */
+    while (!work.empty()) {
+        int s = work.front();
+        work.pop();
+        inWork[s] = false;
+        goMinimal(s, work, inWork);
+    }
+    /* 重新求转移后可能留下不可达的状态，从初始状态开始按广度优先重新编号 */
+    vector<int> id(MS.size(), -1);
+    vector<int> order;
+    id[0] = 0;
+    order.push_back(0);
+    for (int k = 0; k < order.size(); k++) {
+        MinimalState &S = MS[order[k]];
+        for (int j = 0; j < S.g.size(); j++) {
+            int t = S.g[j].second;
+            if (id[t] < 0) {
+                id[t] = order.size();
+                order.push_back(t);
             }
         }
-    /* 当前状态扩展完毕，移除队列*/
-    Q.pop();
     }
+    /* 合并中的状态不占用固定数组，最终的状态放入规范族前才检查上限 */
+    if (order.size() > MAX_STATES) {
+        printf("%s needs %d states, more than %d\n", lalr ? "LALR1" : "minimal LR1", (int)order.size(), MAX_STATES);
+        return false;
+    }
+    /* 把最终的状态放入项目集规范族，后面直接复用分析表的构造 */
+    resetDFA();
+    arena.clear();
+    for (int k = 0; k < order.size(); k++) {
+        LR1Items I;
+        I.begin = expandKernel(order[k]);
+        I.end = arena.size();
+        CC.items.push_back(I);
+        MinimalState &S = MS[order[k]];
+        for (int j = 0; j < S.g.size(); j++) {
+            CC.g[k].push_back(pair<char, int>(S.g[j].first, id[S.g[j].second]));
+        }
+    }
+    return true;
+}
+
+/* 分析表占用的字节数 */
+int tableBytes(int states)
+{
+    return states * (grammar.T.size() * sizeof(table.action[0][0]) + grammar.N.size() * sizeof(table.goton[0][0]));
+}
+
+/* 超出内存预算或状态数上限时放弃规范LR1，释放项目池，按LR0核心合并状态重新构建(LALR1)，状态数与LR0相同。
+ * LALR1也超出状态数上限时返回false */
+bool fallbackDFA()
+{
+    resetDFA();
+    vector<LR1Item>().swap(arena);
+    lalr = true;
+    bool ok = minimalDFA();
+    lalr = false;
+    if (ok) {
+        printf("fell back to LALR1: %d states\n", (int)CC.items.size());
+    }
+    return ok;
+}
+
+/* 位集合占用的字节数 */
+long long bitsBytes(const Bits &b)
+{
+    return sizeof(b) + b.capacity() * sizeof(b[0]);
+}
+
+/* map和set按每个元素一个红黑树结点计算，结点头为颜色和三个指针 */
+const int RB_NODE = 32;
+
+/* 输出各个数据结构占用的内存 */
+void printMemory()
+{
+    long long items = arena.capacity() * sizeof(LR1Item);
+    /* 状态：规范族中的项目集区间，最小LR1和LALR1模式下还有合并用的状态 */
+    long long states = CC.items.capacity() * sizeof(LR1Items) + MS.capacity() * sizeof(MinimalState);
+    for (int s = 0; s < MS.size(); s++) {
+        states += MS[s].core.capacity() * sizeof(MS[s].core[0]) + MS[s].g.capacity() * sizeof(MS[s].g[0]);
+        for (int i = 0; i < MS[s].la.size(); i++) {
+            states += bitsBytes(MS[s].la[i]);
+        }
+    }
+    long long graph = sizeof(CC.g);
+    for (int i = 0; i < MAX_STATES; i++) {
+        graph += CC.g[i].capacity() * sizeof(CC.g[i][0]);
+    }
+    /* 分析表是固定大小的数组，另外加上冲突记录和单产生式链的堆空间 */
+    long long tables = sizeof(table.action) + sizeof(table.goton) + sizeof(table.actions) + sizeof(table.gotoChain) +
+                        sizeof(table.defaultReduce) + sizeof(table.precedenceError);
+    for (int i = 0; i < MAX_STATES; i++) {
+        for (int j = 0; j < MAX_SYMBOLS; j++) {
+            tables += table.actions[i][j].capacity() * sizeof(table.actions[i][j][0]) +
+                      table.gotoChain[i][j].capacity() * sizeof(int);
+        }
+    }
+    /* FIRST集、产生式右部各个后缀的FIRST集和闭包模板 */
+    long long firsts = 0;
+    for (auto it = first.begin(); it != first.end(); it++) {
+        firsts += RB_NODE + sizeof(*it) + it->second.size() * (RB_NODE + sizeof(char));
+    }
+    for (int i = 0; i < suffixFirst.size(); i++) {
+        for (int j = 0; j < suffixFirst[i].size(); j++) {
+            firsts += sizeof(suffixFirst[i][j]) + suffixFirst[i][j].capacity();
+        }
+        firsts += sizeof(suffixNullable[i]) + suffixNullable[i].capacity() / 8;
+    }
+    long long templates = 0;
+    for (int b = 0; b < closureOf.size(); b++) {
+        templates += bitsBytes(closureOf[b].prods) + bitsBytes(closureOf[b].prop);
+        for (int i = 0; i < closureOf[b].spont.size(); i++) {
+            templates += bitsBytes(closureOf[b].spont[i]);
+        }
+    }
+    printf("memory: items %lld, states %lld, CC.g %lld, tables %lld (%d in use), FIRST %lld, closure templates %lld, total %lld bytes\n",
+           items, states, graph, tables, tableBytes(CC.items.size()), firsts, templates,
+           items + states + graph + tables + firsts + templates);
+}
 
+/* 打印项目集规范族和DFA */
+void printDFA()
+{
     printf("CC size: %d\n", CC.items.size());
     for (int i = 0; i < CC.items.size(); i++) {
         printf("LR1Items %d:\n", i);
@@ -401,63 +921,63 @@ void DFA()
         }
     }
 }
-/* 生成LR1分析表 */
-void productLR1AnalysisTabel()
+/* 生成LR1分析表中状态i的一行，要求状态i的转移已经求出 */
+void productLR1AnalysisRow(int i)
 {
-    for (int i = 0; i < CC.items.size(); i++) {
-        LR1Items &LIt= CC.items[i];
-        /* 构建action表 */
-        for (auto it = LIt.items.begin(); it != LIt.items.end(); it++) {
-            LR1Item &L = *it;
-            /* 非规约项目 */
-            if (L.location < L.p.rigths.size()) {
-                char a = L.p.rigths[L.location];
-                int j = isInT(a);
-                /* a是终结符 */
-                if (j > 0) {
-                    j = j - 1;
-                    /* 找到对应a的出边，得到其转移到的状态 */
-                    for (int k = 0; k < CC.g[i].size(); k++) {
-                        pair<char, int> p = CC.g[i][k];
-                        if (p.first == a) {
-                            action[i][j].first = 1; // 1->S
-                            action[i][j].second = p.second;  //转移状态
-                            break;
-                        }
-                    }
-                }
-            } else { // 规约项目
-                /* 接受项目 */
-                if (L.p.left == grammar.prods[0].left) {
-                    if (L.next == '$')
-                        action[i][grammar.T.size() - 1].first = 3;
-                } else {
-                    /* 终结符 */
-                    int  j = isInT(L.next) - 1;
-                    /* 找到产生式对应的序号 */
-                    for (int k = 0; k < grammar.prods.size(); k++) {
-                        if (L.p == grammar.prods[k]) {
-                            action[i][j].first = 2;
-                            action[i][j].second = k;
-                            break;
-                        }
+    LR1Items &LIt= CC.items[i];
+    /* 构建action表 */
+    for (int it = LIt.begin; it != LIt.end; it++) {
+        LR1Item &L = arena[it];
+        Production &P = grammar.prods[L.prod];
+        /* 非规约项目 */
+        if (L.location < P.rigths.size()) {
+            char a = P.rigths[L.location];
+            int j = isInT(a);
+            /* a是终结符 */
+            if (j > 0) {
+                j = j - 1;
+                /* 找到对应a的出边，得到其转移到的状态 */
+                for (int k = 0; k < CC.g[i].size(); k++) {
+                    pair<char, int> p = CC.g[i][k];
+                    if (p.first == a) {
+                        table.setAction(i, j, 1, p.second); // 1->S，转移状态
+                        break;
                     }
-
                 }
             }
-        }
-        /* 构建goto表 */
-        for (int k = 0; k < CC.g[i].size(); k++) {
-            pair<char, int> p = CC.g[i][k];
-            char A = p.first;
-            int j = isInN(A);
-            /* 终结符 */
-            if (j > 0) {
-                j = j - 1;
-                goton[i][j] = p.second; //转移状态
+        } else { // 规约项目
+            /* 接受项目 */
+            if (P.left == grammar.prods[0].left) {
+                if (L.next == '$')
+                    table.setAction(i, grammar.T.size() - 1, 3, 0);
+            } else {
+                /* 终结符 */
+                int  j = isInT(L.next) - 1;
+                /* 项目中直接保存了产生式序号 */
+                table.setAction(i, j, 2, L.prod);
             }
         }
     }
+    /* 构建goto表 */
+    for (int k = 0; k < CC.g[i].size(); k++) {
+        pair<char, int> p = CC.g[i][k];
+        char A = p.first;
+        int j = isInN(A);
+        /* 终结符 */
+        if (j > 0) {
+            j = j - 1;
+            table.goton[i][j] = p.second; //转移状态
+        }
+    }
+    table.resolveByPrecedence(i, grammar);
+}
+
+/* 生成LR1分析表 */
+void productLR1AnalysisTabel()
+{
+    for (int i = 0; i < CC.items.size(); i++) {
+        productLR1AnalysisRow(i);
+    }
     /* 打印LR1分析表 */
     for (int i = 0; i < grammar.T.size() / 2; i++)
         printf("\t");
@@ -477,11 +997,11 @@ void productLR1AnalysisTabel()
     for (int i = 0; i < CC.items.size(); i++) {
         printf("%d\t", i);
         for (int j = 0; j < grammar.T.size(); j++) {
-            if (action[i][j].first == 1) {
-                printf("%c%d\t", 'S', action[i][j].second);
-            } else if (action[i][j].first == 2) {
-                printf("%c%d\t", 'R', action[i][j].second);
-            } else if (action[i][j].first == 3) {
+            if (table.action[i][j].first == 1) {
+                printf("%c%d\t", 'S', table.action[i][j].second);
+            } else if (table.action[i][j].first == 2) {
+                printf("%c%d\t", 'R', table.action[i][j].second);
+            } else if (table.action[i][j].first == 3) {
                 printf("ACC\t");
             } else {
                 printf("\t");
@@ -489,8 +1009,8 @@ void productLR1AnalysisTabel()
         }
         printf("|\t");
         for (int j = 1; j < grammar.N.size(); j++) {
-            if (goton[i][j]) {
-                printf("%d\t", goton[i][j]);
+            if (table.goton[i][j]) {
+                printf("%d\t", table.goton[i][j]);
             } else {
                 printf("\t");
             }
@@ -498,10 +1018,32 @@ void productLR1AnalysisTabel()
         }
         printf("\n");
     }
+    if (table.resolvedConflicts) {
+        printf("precedence: %d conflicts resolved\n", table.resolvedConflicts);
+    }
+    table.printConflicts(grammar, CC.items.size());
+}
+
+/* 懒惰模式下构建状态s的转移和分析表的行，已构建过则直接返回。转移到的状态超出上限时返回false */
+bool materializeState(int s)
+{
+    if (built[s])
+        return true;
+    if (!go(s)) {
+        printf("lazy: more than %d states\n", MAX_STATES);
+        return false;
+    }
+    productLR1AnalysisRow(s);
+    built[s] = true;
+    return true;
 }
 
+/* 重新编号要用到分析程序，定义在process()之后 */
+void profileTables();
+bool parseCorpusLine(const string &s);
 
-void initGrammar()
+/* 读入文法并构建分析表，状态数超出上限时返回false */
+bool initGrammar()
 {
     printf("Please enter the num of production:\n");
     cin >> grammar.num;
@@ -529,58 +1071,355 @@ void initGrammar()
         grammar.T.push_back(ch);
         cin >> ch;
     }
+    /* 可选的优先级声明，每行为"%left/%right/%nonassoc 终结符... #"，后声明的优先级高 */
+    table.precedence.read(cin);
+    /* 删去无用和不可达的符号及产生式 */
+    reduceGrammar(grammar);
     /* 把$当作终结符 */
     grammar.T.push_back('$');
     /* 求FIRST集 */
     getFirstSet();
+    getSuffixFirstSet();
 
-    /* 构建DFA和SLR1预测分析表 */
-    DFA();
-    productLR1AnalysisTabel();
+    if (lazy) {
+        /* 懒惰模式只构建初始项目集，其余状态在分析时按需构建 */
+        initDFA();
+    } else if (minimal) {
+        /* 先构建规范LR1，只用于比较状态数，超出内存预算时不比较 */
+        bool built = DFA();
+        int canonical = CC.items.size();
+        resetDFA();
+        if (!minimalDFA()) {
+            return false;
+        }
+        printDFA();
+        productLR1AnalysisTabel();
+        printf("minimal LR1: %d states, %d table bytes\n", (int)CC.items.size(), tableBytes(CC.items.size()));
+        if (built) {
+            printf("canonical LR1: %d states, %d table bytes\n", canonical, tableBytes(canonical));
+        }
+        if (optimize) {
+            table.optimizeTable(grammar, CC.items.size());
+        }
+        printMemory();
+    } else {
+        /* 构建DFA和LR1分析表，超出内存预算时改为LALR1 */
+        if (!DFA() && !fallbackDFA()) {
+            return false;
+        }
+        printDFA();
+        productLR1AnalysisTabel();
+        if (optimize) {
+            table.optimizeTable(grammar, CC.items.size());
+        }
+        printMemory();
+    }
+    if (!trainFile.empty()) {
+        profileTables();
+    }
+    if (!latencyCorpus.empty()) {
+        bool e = eval;
+        eval = false;
+        quiet = true;
+        measureLatency(latencyCorpus, latencyJson, parseCorpusLine);
+        quiet = false;
+        eval = e;
+    }
     
     /* 读入待分析串并初始化分析栈 */
     printf("Please enter the String to be analyzed:\n");
     cin >> str;
+    if (eval) {
+        values.bind(grammar.prods);
+        values.lexNumbers(str);
+    }
     str += '$';
     ST.push(pair<int, char>(0, '-'));
+    return true;
+}
+/* 按产生式p规约：弹出pop个符号并输出产生式，再按goto表转移 */
+void reduceBy(int p, int pop)
+{
+    Production &P = grammar.prods[p];
+    /* 弹出并输出产生式 */
+    if (!quiet) {
+        printf("%c->", P.left);
+        for (int i = 0; i < P.rigths.size(); i++) {
+            printf("%c", P.rigths[i]);
+        }
+        printf("\n");
+    }
+    for (int i = 0; i < pop; i++) {
+        ST.pop();
+    }
+    /* 移进-规约合并时移进的符号已经压入了值栈，按右部全长弹出 */
+    if (eval) {
+        values.reduce(p, P.rigths.size());
+    }
+    int s = ST.top().first;
+    int j = isInN(P.left) - 1;
+    if (profiling) {
+        prodHits[p]++;
+        nontermHits[j]++;
+    }
+    /* 输出优化时跳过的单产生式规约 */
+    vector<int> &chain = table.gotoChain[s][j];
+    for (int k = 0; k < chain.size(); k++) {
+        Production &U = grammar.prods[chain[k]];
+        if (profiling) {
+            prodHits[chain[k]]++;
+        }
+        if (!quiet) {
+            printf("%c->%c\n", U.left, U.rigths[0]);
+        }
+        if (eval) {
+            values.reduce(chain[k], 1);
+        }
+    }
+    savedSteps += chain.size();
+    ST.push(pair<int, char>(table.goton[s][j], chain.empty() ? P.left : grammar.prods[chain.back()].left));
 }
 /* 分析程序 */
-void process()
+/* 分析程序，接受时返回true，quiet时遇到错误返回false */
+bool process()
 {
     int ip = 0;
-    printf("The ans:\n");
+    steps = 0;
+    savedSteps = 0;
+    if (!quiet) {
+        printf("The ans:\n");
+    }
     do {
+        steps++;
         int s = ST.top().first;
+        /* 懒惰模式下第一次进入该状态时才构建其分析表的行 */
+        if (lazy && !materializeState(s)) {
+            return false;
+        }
+        if (profiling) {
+            stateHits[s]++;
+        }
+        /* 默认规约不必查看向前看符号 */
+        if (optimize && table.defaultReduce[s] >= 0) {
+            int p = table.defaultReduce[s];
+            TRACE_EVENT(TRACE_REDUCE, s, ip, p);
+            reduceBy(p, grammar.prods[p].rigths.size());
+            TRACE_EVENT(TRACE_GOTO, ST.top().first, ip, ST.top().second);
+            continue;
+        }
         char a = str[ip];
         int j = isInT(a) - 1;
+        if (quiet && j < 0) {
+            TRACE_EVENT(TRACE_ERROR, s, ip, a);
+            return false;
+        }
+        if (profiling) {
+            termHits[j]++;
+        }
         /* 移进 */
-        if (action[s][j].first == 1) {
-            ST.push(pair<int, char>(action[s][j].second, a));
+        if (table.action[s][j].first == 1) {
+            TRACE_EVENT(TRACE_SHIFT, s, ip, table.action[s][j].second);
+            ST.push(pair<int, char>(table.action[s][j].second, a));
+            if (eval) {
+                values.shift(ip);
+            }
+            ip = ip + 1;
+        } else if (table.action[s][j].first == 2) { // 规约
+            int p = table.action[s][j].second;
+            TRACE_EVENT(TRACE_REDUCE, s, ip, p);
+            reduceBy(p, grammar.prods[p].rigths.size());
+            TRACE_EVENT(TRACE_GOTO, ST.top().first, ip, ST.top().second);
+        } else if (table.action[s][j].first == 4) { // 移进后立即规约，移进的符号不必入栈
+            int p = table.action[s][j].second;
+            if (eval) {
+                values.shift(ip);
+            }
             ip = ip + 1;
-        } else if (action[s][j].first == 2) { // 规约
-            Production &P = grammar.prods[action[s][j].second];
-            /* 弹出并输出产生式 */
-            printf("%c->", P.left);
-            for (int i = 0; i < P.rigths.size(); i++) {
-                ST.pop();
-                printf("%c", P.rigths[i]);
+            savedSteps++;
+            TRACE_EVENT(TRACE_REDUCE, s, ip, p);
+            reduceBy(p, grammar.prods[p].rigths.size() - 1);
+            TRACE_EVENT(TRACE_GOTO, ST.top().first, ip, ST.top().second);
+        } else if (table.action[s][j].first == 3) {   //接受
+            TRACE_EVENT(TRACE_ACCEPT, s, ip, 0);
+            if (quiet) {
+                return true;
             }
-            printf("\n");
-            s = ST.top().first;
-            char A = P.left;
-            j = isInN(A) - 1;
-            ST.push(pair<int, char>(goton[s][j], A));
-        } else if (action[s][j].first == 3) {   //接受
             printf("ACC\n");
-            return;
+            if (eval) {
+                printf("value: %g\n", values.top());
+            }
+            if (lazy) {
+                int cnt = 0;
+                for (int i = 0; i < CC.items.size(); i++) {
+                    cnt += built[i];
+                }
+                printf("lazy: %d of %d discovered states built\n", cnt, (int)CC.items.size());
+            }
+            if (optimize) {
+                int tokens = str.size();
+                printf("steps: %d (unoptimized %d), %.2f -> %.2f steps per token\n", steps, steps + savedSteps,
+                       (double)(steps + savedSteps) / tokens, (double)steps / tokens);
+            }
+            if (trace) {
+                printTrace();
+            }
+            return true;
         } else {
+            TRACE_EVENT(TRACE_ERROR, s, ip, a);
+            if (quiet) {
+                return false;
+            }
             printf("error\n");
+            /* 第一次出错时输出跟踪 */
+            if (trace) {
+                printTrace();
+                trace = false;
+            }
         }
     } while(1);
 }
-int main()
+
+/* 清空分析栈，只留下初始状态 */
+void resetStack()
+{
+    while (!ST.empty()) {
+        ST.pop();
+    }
+    ST.push(pair<int, char>(0, '-'));
+}
+
+/* 不输出地依次分析语料中的每个串，返回接受的串数 */
+int runCorpus(vector<string> &corpus)
+{
+    int accepted = 0;
+    for (int k = 0; k < corpus.size(); k++) {
+        str = corpus[k];
+        resetStack();
+        if (process()) {
+            accepted++;
+        }
+    }
+    return accepted;
+}
+
+/* 反复分析语料至少0.2秒，返回每秒分析的符号数 */
+double throughput(vector<string> &corpus)
+{
+    long long symbols = 0;
+    for (int k = 0; k < corpus.size(); k++) {
+        symbols += corpus[k].size();
+    }
+    runCorpus(corpus);
+    long long rounds = 0;
+    double elapsed = 0;
+    auto begin = chrono::steady_clock::now();
+    while (elapsed < 0.2) {
+        runCorpus(corpus);
+        rounds++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    }
+    return symbols * rounds / elapsed;
+}
+
+/* 用训练语料统计使用次数并重新编号，比较重新编号前后分析留出语料的速度 */
+void profileTables()
 {
-    initGrammar();
-    process();
+    vector<string> train, heldout;
+    if (!readCorpus(trainFile, train) || !readCorpus(heldoutFile, heldout)) {
+        printf("cannot read corpus %s %s\n", trainFile.c_str(), heldoutFile.c_str());
+        return;
+    }
+    /* 语料中的串按符号分析，不计算值 */
+    bool e = eval;
+    eval = false;
+    quiet = true;
+    double before = throughput(heldout);
+    stateHits.assign(CC.items.size(), 0);
+    termHits.assign(grammar.T.size(), 0);
+    nontermHits.assign(grammar.N.size(), 0);
+    prodHits.assign(grammar.prods.size(), 0);
+    profiling = true;
+    int accepted = runCorpus(train);
+    profiling = false;
+    table.renumberByProfile(grammar, CC, arena, stateHits, termHits, nontermHits, prodHits);
+    double after = throughput(heldout);
+    quiet = false;
+    eval = e;
+    while (!ST.empty()) {
+        ST.pop();
+    }
+    printf("profile: %d of %d training inputs accepted, %d held-out inputs\n", accepted, (int)train.size(), (int)heldout.size());
+    printf("profile: %.1f -> %.1f M symbols/s (%.2fx)\n", before / 1e6, after / 1e6, after / before);
+}
+
+/* 不输出地分析语料中的一个串，--latency计时用 */
+bool parseCorpusLine(const string &s)
+{
+    str = s;
+    resetStack();
+    return process();
+}
+
+/* GLR模式 */
+bool glr = false;
+
+int main(int argc, char *argv[])
+{
+    /* --lazy 按需构建分析表，--minimal 构建最小LR1分析表，--glr 使用GLR分析程序，
+     * --optimize 优化分析表，--eval 输入串中可以写数字，分析的同时执行语义动作计算值，
+     * --profile TRAIN HELDOUT 按训练语料中的使用次数重新编号并比较留出语料的分析速度，
+     * --latency CORPUS JSON 把语料中每个串的分析延迟写成JSON，--trace 输出编译时打开的分析跟踪，
+     * --memory-budget BYTES 规范LR1构建超出内存预算时改为LALR1 */
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--lazy") {
+            lazy = true;
+        } else if (string(argv[i]) == "--minimal") {
+            minimal = true;
+        } else if (string(argv[i]) == "--glr") {
+            glr = true;
+        } else if (string(argv[i]) == "--optimize") {
+            optimize = true;
+        } else if (string(argv[i]) == "--eval") {
+            eval = true;
+            values.registerArithmetic();
+        } else if (string(argv[i]) == "--profile" && i + 2 < argc) {
+            trainFile = argv[i + 1];
+            heldoutFile = argv[i + 2];
+            i += 2;
+        } else if (string(argv[i]) == "--latency" && i + 2 < argc) {
+            latencyCorpus = argv[i + 1];
+            latencyJson = argv[i + 2];
+            i += 2;
+        } else if (string(argv[i]) == "--trace") {
+            trace = true;
+        } else if (string(argv[i]) == "--memory-budget" && i + 1 < argc) {
+            /* 可以带K、M、G后缀 */
+            char *end;
+            memoryBudget = strtoll(argv[++i], &end, 10);
+            if (*end == 'K' || *end == 'k') {
+                memoryBudget <<= 10;
+            } else if (*end == 'M' || *end == 'm') {
+                memoryBudget <<= 20;
+            } else if (*end == 'G' || *end == 'g') {
+                memoryBudget <<= 30;
+            }
+        }
+    }
+    /* GLR、分析表优化和重新编号都需要完整的分析表，不使用懒惰模式 */
+    if (glr || optimize || !trainFile.empty()) {
+        lazy = false;
+    }
+    /* GLR分析程序不处理优化后的动作和被跳过的单产生式规约，不优化分析表 */
+    if (glr) {
+        optimize = false;
+    }
+    if (!initGrammar()) {
+        return 1;
+    }
+    if (glr) {
+        GLRParser<Grammar>(grammar, table).parse(str);
+    } else {
+        process();
+    }
     return 0;
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include <cstdio>
+#include <cstdlib>
+#include <cctype>
 #include <vector>
 #include <string>
 #include <iostream>
@@ -6,6 +8,15 @@
 #include <set>
 #include <stack>
 #include <queue>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <chrono>
+#include "glr.h"
+#include "lrtable.h"
+#include "semantic.h"
+#include "simplify.h"
+#include "trace.h"
 using namespace std;
 
 /* 产生式结构体，左部符号和右部符号串 */
@@ -28,16 +39,22 @@ struct Production {
 
 /* LR0项目 */
 struct LR0Item {
-    Production p;
+    /* 产生式序号 */
+    int prod;
     /* 点的位置 */
     int location;
 };
 
-/* LR0项目集 */
+/* LR0项目集，其项目保存在项目池arena的[begin, end)区间中 */
 struct LR0Items {
-    vector<LR0Item> items;
+    int begin;
+    int end;
 };
 
+/* 项目池，一次构建中所有项目集的项目都从这里分配。
+ * 转移得到的候选项目集直接在池的末尾构造，若与已有项目集重复则回退 */
+vector<LR0Item> arena;
+
 /* LR0项目集规范族 */
 struct CanonicalCollection {
     /* 项目集集合 */
@@ -58,18 +75,42 @@ struct Grammar {
 map<char, set<char> > first;
 map<char, set<char> > follow;
 
+/* 产生式右部各个后缀的FIRST集(不含空，按字符排好序)和能否推空，
+ * suffixFirst[i][j]为第i个产生式右部从第j个符号开始的后缀的FIRST集 */
+vector< vector< vector<char> > > suffixFirst;
+vector< vector<bool> > suffixNullable;
+
 /* DFA队列， 用于存储待转移的有效项目集 */
-queue< pair<LR0Items, int> > Q;
+queue<int> Q; // 保存状态序号
 
-/* action表和goto表 */
-pair<int, int> action[100][100]; // first表示分析动作，0->ACC 1->S 2->R second表示转移状态或者产生式序号
-int goton[100][100];
+/* 分析表，生成后按需优化：默认规约、单产生式(A->B)规约的消除、移进-规约合并 */
+LRTable table;
+bool optimize = false;
+/* 分析步数，以及优化省去的步数 */
+int steps, savedSteps;
 
 /* 待分析串 */
 string str;
+
+/* --profile 用训练语料统计状态、终结符、非终结符和产生式的使用次数，按次数重新编号，
+ * 再比较重新编号前后分析留出语料的速度。profiling时process()计数，quiet时process()不输出 */
+string trainFile, heldoutFile;
+bool profiling = false, quiet = false;
+vector<long long> stateHits, termHits, nontermHits, prodHits;
+
+/* --latency CORPUS JSON 逐个分析语料中的串，把每个串的分析延迟的分位数和直方图写到JSON文件 */
+string latencyCorpus, latencyJson;
+
+/* --trace 在接受或第一次出错时输出trace.h记录的分析事件 */
+bool trace = false;
 /* 分析栈 */
 stack< pair<int, char> > ST; // first是state，second 是symble
 
+/* 语义动作模式：输入串中的数字当作终结符n，分析的同时计算值 */
+bool eval = false;
+/* 语义动作和值栈 */
+ValueStack values;
+
 /* 判断ch是否是终结符 */
 int isInT(char ch)
 {
@@ -197,6 +238,46 @@ void getFirstByAlphaSet(vector<char> &alpha, set<char> &FS)
         FS.insert('&');
     }
 }
+/* 预先求出每个产生式右部每个后缀的FIRST集和能否推空 */
+void getSuffixFirstSet()
+{
+    suffixFirst.assign(grammar.prods.size(), vector< vector<char> >());
+    suffixNullable.assign(grammar.prods.size(), vector<bool>());
+    for (int i = 0; i < grammar.prods.size(); i++) {
+        Production &P = grammar.prods[i];
+        int n = P.rigths.size();
+        suffixFirst[i].assign(n + 1, vector<char>());
+        suffixNullable[i].assign(n + 1, false);
+        /* 空后缀能推空 */
+        suffixNullable[i][n] = true;
+        /* 从后往前求，后缀j的FIRST集为FIRST(X_j)，若X_j能推空则再并上后缀j+1的FIRST集 */
+        for (int j = n - 1; j >= 0; j--) {
+            char X = P.rigths[j];
+            set<char> FS;
+            bool nullable = false;
+            if (X == '&') {
+                nullable = true;
+            } else if (isInT(X)) {
+                FS.insert(X);
+            } else {
+                set<char> &FX = first[X];
+                for (auto it = FX.begin(); it != FX.end(); it++) {
+                    if (*it == '&') {
+                        nullable = true;
+                    } else {
+                        FS.insert(*it);
+                    }
+                }
+            }
+            if (nullable) {
+                FS.insert(suffixFirst[i][j + 1].begin(), suffixFirst[i][j + 1].end());
+                nullable = suffixNullable[i][j + 1];
+            }
+            suffixFirst[i][j].assign(FS.begin(), FS.end());
+            suffixNullable[i][j] = nullable;
+        }
+    }
+}
 /* 求非终结符的FOLLOW集 */
 void getFollowSet()
 {
@@ -220,12 +301,8 @@ void getFollowSet()
                 /* 当前符号是非终结符 */
                 if (isInN(B)) {
                     set<char> &FB = follow[B];
-                    set<char> FS;
-                    /* alpha是从当前符号下一个符号开始的符号串 */
-                    vector<char> alpha(P.rigths.begin() + j + 1, P.rigths.end());
-                    /* 求alpha的FIRST集，即FS */
-                    getFirstByAlphaSet(alpha, FS);
-                    // printf("%c:\n", B);
+                    /* 取出预先求好的从当前符号下一个符号开始的后缀的FIRST集 */
+                    vector<char> &FS = suffixFirst[i][j + 1];
                     /* 将alpha的FIRST集中所有非空元素加入到当前符号的FOLLOW集中 */
                     for (auto it = FS.begin(); it != FS.end(); it++) {
                         // printf("%c ", *it);
@@ -239,9 +316,8 @@ void getFollowSet()
                         }
                     }
                     // printf("\n");
-                    /* 如果alpha能推空，或者当前符号是产生式右部末尾，则将文法左部符号的FOLLOW集加入到当前符号的FOLLOW集中 */
-                    auto itt = FS.find('&');
-                    if (itt != FS.end() || (j + 1) >= P.rigths.size()) {
+                    /* 如果alpha能推空(当前符号是产生式右部末尾时alpha为空)，则将文法左部符号的FOLLOW集加入到当前符号的FOLLOW集中 */
+                    if (suffixNullable[i][j + 1]) {
                         char A = P.left;
                         for (auto it = follow[A].begin(); it != follow[A].end(); it++) {
                             auto itt = FB.find(*it);
@@ -266,12 +342,12 @@ void getFollowSet()
         printf("\n");
     }
 }
-/* 判断是LR0项目t否在有效项目集I中 */
-bool isInLR0Items(LR0Items &I, LR0Item &t)
+/* 判断LR0项目t是否在项目池的[begin, end)区间中 */
+bool isInLR0Items(int begin, int end, LR0Item &t)
 {
-    for (auto it = I.items.begin(); it != I.items.end(); it++) {
-        LR0Item &item = *it;
-        if (item.p == t.p && item.location == t.location) 
+    for (int i = begin; i < end; i++) {
+        LR0Item &item = arena[i];
+        if (item.prod == t.prod && item.location == t.location)
             return true;
     }
     return false;
@@ -280,70 +356,117 @@ bool isInLR0Items(LR0Items &I, LR0Item &t)
 /* 打印某个项目集 */
 void printLR0Items(LR0Items &I)
 {
-    for (auto it = I.items.begin(); it != I.items.end(); it++) {
-        LR0Item &L = *it;
-        printf("%c->", L.p.left);
-        for (int i = 0; i < L.p.rigths.size(); i++) {
+    for (int k = I.begin; k < I.end; k++) {
+        LR0Item &L = arena[k];
+        Production &P = grammar.prods[L.prod];
+        printf("%c->", P.left);
+        for (int i = 0; i < P.rigths.size(); i++) {
             if (L.location == i)
                 printf(".");
-            printf("%c", L.p.rigths[i]);
+            printf("%c", P.rigths[i]);
         }
-        if (L.location == L.p.rigths.size())
+        if (L.location == P.rigths.size())
             printf(".");
         printf(" ");
     }
     printf("\n");
 }
 
-/* 求I的闭包 */
-void closure(LR0Items &I)
+/* 位集合，用来表示产生式集合 */
+typedef vector<unsigned long long> Bits;
+bool testBit(const Bits &b, int i)
 {
-    bool change =  true;
-    while (change) {
-        change = false;
-        LR0Items J;
-        /* 枚举每个项目 */
-        J.items.assign(I.items.begin(), I.items.end());
-        for (auto it = J.items.begin(); it != J.items.end(); it++) {
-            LR0Item &L = *it;
-            /* 非规约项目 */
-            if (L.location < L.p.rigths.size()) {
-                char B = L.p.rigths[L.location];
-                if (isInN(B)) {
-                    /* 把符合条件的LR0项目加入闭包中 */
-                    for (int i = 0; i < grammar.prods.size(); i++) {
-                        Production &P = grammar.prods[i];
-                        if (P.left == B) {
-                            LR0Item t;
-                            t.location = 0;
-                            t.p.left = P.left;
-                            t.p.rigths.assign(P.rigths.begin(), P.rigths.end());
-                            if (!isInLR0Items(I, t)) {
-                                /* 标记改变 */
-                                change = true;
-                                I.items.push_back(t);
-                            } 
-                        } 
-                    }
+    return (b[i >> 6] >> (i & 63)) & 1;
+}
+void setBit(Bits &b, int i)
+{
+    b[i >> 6] |= 1ULL << (i & 63);
+}
+
+/* 非终结符的闭包模板，closureOf[j]为第j个非终结符B的LR0闭包中所有B->.γ及由其引入的产生式，
+ * 与具体状态无关，求闭包时直接合并 */
+vector<Bits> closureOf;
+
+/* 预先求出每个非终结符的闭包模板 */
+void getClosureTemplates()
+{
+    int words = (grammar.prods.size() + 63) / 64;
+    closureOf.assign(grammar.N.size(), Bits(words, 0));
+    for (int b = 0; b < grammar.N.size(); b++) {
+        Bits &C = closureOf[b];
+        /* 已经加入模板的非终结符，及待处理的非终结符 */
+        vector<bool> visited(grammar.N.size(), false);
+        vector<int> work;
+        visited[b] = true;
+        work.push_back(b);
+        while (!work.empty()) {
+            char B = grammar.N[work.back()];
+            work.pop_back();
+            for (int i = 0; i < grammar.prods.size(); i++) {
+                Production &P = grammar.prods[i];
+                if (P.left != B)
+                    continue;
+                setBit(C, i);
+                /* 右部第一个符号是非终结符，其产生式也要加入 */
+                int j = isInN(P.rigths[0]) - 1;
+                if (j >= 0 && !visited[j]) {
+                    visited[j] = true;
+                    work.push_back(j);
+                }
+            }
+        }
+    }
+}
+
+/* 求项目池中从begin开始到末尾的项目集的闭包，新项目直接追加到池末尾 */
+void closure(int begin)
+{
+    /* 要加入的产生式集合，重复使用 */
+    static Bits S;
+    S.assign(closureOf.empty() ? 0 : closureOf[0].size(), 0);
+    int end = arena.size();
+    /* 合并每个点后面是非终结符的项目对应的闭包模板 */
+    for (int k = begin; k < end; k++) {
+        LR0Item &L = arena[k];
+        Production &P = grammar.prods[L.prod];
+        /* 非规约项目 */
+        if (L.location < P.rigths.size()) {
+            int b = isInN(P.rigths[L.location]) - 1;
+            if (b >= 0) {
+                Bits &C = closureOf[b];
+                for (int w = 0; w < S.size(); w++) {
+                    S[w] |= C[w];
                 }
             }
         }
     }
+    /* 把符合条件的LR0项目加入闭包中 */
+    for (int i = 0; i < grammar.prods.size(); i++) {
+        if (testBit(S, i)) {
+            LR0Item t;
+            t.prod = i;
+            t.location = 0;
+            /* 只有初始项目集的核心中可能已有点在最左边的项目 */
+            if (!isInLR0Items(begin, end, t)) {
+                arena.push_back(t);
+            }
+        }
+    }
 }
-/* 判断是否在项目集规范族中，若在返回序号 */
-int isInCanonicalCollection(LR0Items &I)
+/* 判断从begin开始到池末尾的项目集是否在项目集规范族中，若在返回序号 */
+int isInCanonicalCollection(int begin)
 {
+    int size = arena.size() - begin;
     for (int i = 0; i < CC.items.size(); i++) {
         LR0Items &J = CC.items[i];
         bool flag = true;
-        if (J.items.size() != I.items.size()) {
+        if (J.end - J.begin != size) {
             flag = false;
             continue;
         }
         /* 每个项目都在该项目集中，则认为这个两个项目集相等 */
-        for (auto it = I.items.begin(); it != I.items.end(); it++) {
-            LR0Item &t = *it;
-            if (!isInLR0Items(J, t)) {
+        for (int k = begin; k < arena.size(); k++) {
+            if (!isInLR0Items(J.begin, J.end, arena[k])) {
                 flag = false;
                 break;
             }
@@ -355,91 +478,98 @@ int isInCanonicalCollection(LR0Items &I)
     return 0;
 }
 
-/* 转移函数，I为当前的项目集，J为转移后的项目集, 经X转移 */
-void go(LR0Items &I, char X, LR0Items &J)
+/* 把项目池末尾从begin开始的候选项目集加入规范族，返回其序号，已存在时回收其空间 */
+int addLR0Items(int begin)
+{
+    int idx = isInCanonicalCollection(begin);
+    if (idx > 0) {
+        arena.resize(begin);
+        return idx - 1;
+    }
+    LR0Items I;
+    I.begin = begin;
+    I.end = arena.size();
+    CC.items.push_back(I);
+    idx = CC.items.size() - 1;
+    /* 把新加入的有效项目集加入待扩展队列中 */
+    Q.push(idx);
+    return idx;
+}
+
+/* 按点后面的符号比较，用于分桶 */
+bool lessBySymbol(const pair<int, int> &a, const pair<int, int> &b)
+{
+    return a.first < b.first;
+}
+
+/* 转移函数，扫描一遍状态sidx中的项目，按点后面的符号分桶，
+ * 只对非空的桶构造转移后的项目集(追加到项目池末尾)并加入DFA的边 */
+void go(int sidx)
 {
-    for (auto it = I.items.begin(); it != I.items.end(); it++) {
-        LR0Item &L = *it;
+    /* first为符号序号(终结符在前，非终结符在后)，second为项目在池中的下标，重复使用 */
+    static vector< pair<int, int> > moves;
+    moves.clear();
+    int nt = grammar.T.size();
+    int sbegin = CC.items[sidx].begin;
+    int send = CC.items[sidx].end;
+    for (int k = sbegin; k < send; k++) {
+        LR0Item &L = arena[k];
+        Production &P = grammar.prods[L.prod];
         /* 非规约项目 */
-        if (L.location < L.p.rigths.size()) {
-            char B = L.p.rigths[L.location];
-            /* 如果点后面是非终结符，且非终结符为X，点位置加1, 加入到转移项目集中*/
-            if (B == X) {
-                LR0Item t;
-                t.location = L.location + 1;
-                t.p.left = L.p.left;
-                t.p.rigths.assign(L.p.rigths.begin(), L.p.rigths.end());
-                J.items.push_back(t);
+        if (L.location < P.rigths.size()) {
+            char X = P.rigths[L.location];
+            int j = isInT(X);
+            if (j > 0) {
+                moves.push_back(pair<int, int>(j - 1, k));
+            } else if ((j = isInN(X)) > 0) {
+                moves.push_back(pair<int, int>(nt + j - 1, k));
             }
         }
     }
-    /* 若J中有项目，则求其闭包 */
-    if (J.items.size() > 0) {
-        closure(J);
+    /* 同一个桶内保持项目原来的顺序，使状态编号与逐个符号求转移时一致 */
+    stable_sort(moves.begin(), moves.end(), lessBySymbol);
+    int m = 0;
+    while (m < moves.size()) {
+        int sym = moves[m].first;
+        int begin = arena.size();
+        /* 点位置加1, 加入到转移项目集中 */
+        for (; m < moves.size() && moves[m].first == sym; m++) {
+            /* 追加项目可能使池重新分配，这里拷贝一份 */
+            LR0Item L = arena[moves[m].second];
+            L.location = L.location + 1;
+            arena.push_back(L);
+        }
+        closure(begin);
+        /* 查找是否已经在有效项目集族里，不在则加入 */
+        int idx = addLR0Items(begin);
+        /* 从原状态到转移状态加一条边，边上的值为转移符号 */
+        char X = sym < nt ? grammar.T[sym] : grammar.N[sym - nt];
+        CC.g[sidx].push_back(pair<char, int>(X, idx));
     }
 }
 
 /* 构建DFA和项目集规范族 */
 void DFA()
 {
+    /* 每次构建使用一个新的项目池，预先分配好空间 */
+    arena.clear();
+    arena.reserve(1024);
+    /* 先求出每个非终结符的闭包模板 */
+    getClosureTemplates();
     /* 构建初始项目集 */
     LR0Item t;
+    t.prod = 0;
     t.location = 0;
-    t.p.left = grammar.prods[0].left;
-    t.p.rigths.assign(grammar.prods[0].rigths.begin(), grammar.prods[0].rigths.end());
-    LR0Items I;
-    I.items.push_back(t);
-    closure(I);
+    arena.push_back(t);
+    closure(0);
     /* 加入初始有效项目集 */
-    CC.items.push_back(I);
-    /* 把新加入的有效项目集加入待扩展队列中 */
-    Q.push(pair<LR0Items, int>(I, 0));
+    addLR0Items(0);
     while (!Q.empty()) {
-        LR0Items &S = Q.front().first;
-        int sidx = Q.front().second;
-        /* 遍历每个终结符 */
-        for (int i = 0; i  < grammar.T.size(); i++) {
-            LR0Items D;
-            go(S, grammar.T[i], D);
-            int idx;
-            /* 若不为空 */
-            if (D.items.size() > 0) {
-                /* 查找是否已经在有效项目集族里 */
-                idx = isInCanonicalCollection(D); 
-                if (idx > 0) {
-                    idx = idx - 1;
-                } else {
-                    idx = CC.items.size();
-                    CC.items.push_back(D);
-                    /* 把新加入的有效项目集加入待扩展队列中 */
-                    Q.push(pair<LR0Items, int>(D, idx));
-                }
-                /* 从原状态到转移状态加一条边，边上的值为转移符号 */
-                CC.g[sidx].push_back(pair<char, int>(grammar.T[i], idx));
-            }
-        }
-        /* 遍历每个非终结符 */
-        for (int i = 0; i  < grammar.N.size(); i++) {
-            LR0Items D;
-            go(S, grammar.N[i], D);
-            int idx;
-            if (D.items.size() > 0) {
-                /* 查找是否已经在有效项目集族里 */
-                idx = isInCanonicalCollection(D); 
-                if (idx != 0) {
-                    idx = idx - 1;
-                } else {
-                    idx = CC.items.size();
-                    CC.items.push_back(D);
-                    /* 把新加入的有效项目集加入待扩展队列中 */
-                    Q.push(pair<LR0Items, int>(D, idx));
-                }
-                /* 从原状态到转移状态加一条边，边上的值为转移符号 */
-                CC.g[sidx].push_back(pair<char, int>(grammar.N[i], idx));
-            }
-        }
-    /* 当前状态扩展完毕，移除队列*/
-    Q.pop();
+        int sidx = Q.front();
+        /* 当前状态扩展完毕，移除队列*/
+        Q.pop();
+        /* 一次扫描求出所有非空转移 */
+        go(sidx);
     }
 
     printf("CC size: %d\n", CC.items.size());
@@ -458,11 +588,12 @@ void productSLR1AnalysisTabel()
     for (int i = 0; i < CC.items.size(); i++) {
         LR0Items &LIt= CC.items[i];
         /* 构建action表 */
-        for (auto it = LIt.items.begin(); it != LIt.items.end(); it++) {
-            LR0Item &L = *it;
+        for (int it = LIt.begin; it != LIt.end; it++) {
+            LR0Item &L = arena[it];
+            Production &P = grammar.prods[L.prod];
             /* 非规约项目 */
-            if (L.location < L.p.rigths.size()) {
-                char a = L.p.rigths[L.location];
+            if (L.location < P.rigths.size()) {
+                char a = P.rigths[L.location];
                 int j = isInT(a);
                 /* a是终结符 */
                 if (j > 0) {
@@ -471,31 +602,24 @@ void productSLR1AnalysisTabel()
                     for (int k = 0; k < CC.g[i].size(); k++) {
                         pair<char, int> p = CC.g[i][k];
                         if (p.first == a) {
-                            action[i][j].first = 1; // 1->S
-                            action[i][j].second = p.second;  //转移状态
+                            table.setAction(i, j, 1, p.second); // 1->S，转移状态
                             break;
                         }
                     }
                 }
             } else { // 规约项目
                 /* 接受项目 */
-                if (L.p.left == grammar.prods[0].left) {
-                    action[i][grammar.T.size() - 1].first = 3;
+                if (P.left == grammar.prods[0].left) {
+                    table.setAction(i, grammar.T.size() - 1, 3, 0);
                 } else {
-                    char A = L.p.left;
+                    char A = P.left;
                     for (auto a = follow[A].begin(); a != follow[A].end(); a++) {
                         int j = isInT(*a);
                         /* 终结符 */
                         if (j > 0) {
                             j = j - 1;
-                            /* 找到产生式对应的序号 */
-                            for (int k = 0; k < grammar.prods.size(); k++) {
-                                if (L.p == grammar.prods[k]) {
-                                    action[i][j].first = 2;
-                                    action[i][j].second = k;
-                                    break;
-                                }
-                            }
+                            /* 项目中直接保存了产生式序号 */
+                            table.setAction(i, j, 2, L.prod);
                         }
                     }
                 }
@@ -509,9 +633,10 @@ void productSLR1AnalysisTabel()
             /* 终结符 */
             if (j > 0) {
                 j = j - 1;
-                goton[i][j] = p.second; //转移状态
+                table.goton[i][j] = p.second; //转移状态
             }
         }
+        table.resolveByPrecedence(i, grammar);
     }
     /* 打印SLR1分析表 */
     for (int i = 0; i < grammar.T.size() / 2; i++)
@@ -532,11 +657,11 @@ void productSLR1AnalysisTabel()
     for (int i = 0; i < CC.items.size(); i++) {
         printf("%d\t", i);
         for (int j = 0; j < grammar.T.size(); j++) {
-            if (action[i][j].first == 1) {
-                printf("%c%d\t", 'S', action[i][j].second);
-            } else if (action[i][j].first == 2) {
-                printf("%c%d\t", 'R', action[i][j].second);
-            } else if (action[i][j].first == 3) {
+            if (table.action[i][j].first == 1) {
+                printf("%c%d\t", 'S', table.action[i][j].second);
+            } else if (table.action[i][j].first == 2) {
+                printf("%c%d\t", 'R', table.action[i][j].second);
+            } else if (table.action[i][j].first == 3) {
                 printf("ACC\t");
             } else {
                 printf("\t");
@@ -544,8 +669,8 @@ void productSLR1AnalysisTabel()
         }
         printf("|\t");
         for (int j = 1; j < grammar.N.size(); j++) {
-            if (goton[i][j]) {
-                printf("%d\t", goton[i][j]);
+            if (table.goton[i][j]) {
+                printf("%d\t", table.goton[i][j]);
             } else {
                 printf("\t");
             }
@@ -553,9 +678,17 @@ void productSLR1AnalysisTabel()
         }
         printf("\n");
     }
+    if (table.resolvedConflicts) {
+        printf("precedence: %d conflicts resolved\n", table.resolvedConflicts);
+    }
+    table.printConflicts(grammar, CC.items.size());
 }
 
 
+/* 重新编号要用到分析程序，定义在process()之后 */
+void profileTables();
+bool parseCorpusLine(const string &s);
+
 void initGrammar()
 {
     printf("Please enter the num of production:\n");
@@ -584,59 +717,293 @@ void initGrammar()
         grammar.T.push_back(ch);
         cin >> ch;
     }
+    /* 可选的优先级声明，每行为"%left/%right/%nonassoc 终结符... #"，后声明的优先级高 */
+    table.precedence.read(cin);
+    /* 删去无用和不可达的符号及产生式 */
+    reduceGrammar(grammar);
     /* 把$当作终结符 */
     grammar.T.push_back('$');
     /* 求FIRST集和FOLLOW集 */
     getFirstSet();
+    getSuffixFirstSet();
     getFollowSet();
 
     /* 构建DFA和SLR1预测分析表 */
     DFA();
     productSLR1AnalysisTabel();
+    if (optimize) {
+        table.optimizeTable(grammar, CC.items.size());
+    }
+    if (!trainFile.empty()) {
+        profileTables();
+    }
+    if (!latencyCorpus.empty()) {
+        bool e = eval;
+        eval = false;
+        quiet = true;
+        measureLatency(latencyCorpus, latencyJson, parseCorpusLine);
+        quiet = false;
+        eval = e;
+    }
     
     /* 读入待分析串并初始化分析栈 */
     printf("Please enter the String to be analyzed:\n");
     cin >> str;
+    if (eval) {
+        values.bind(grammar.prods);
+        values.lexNumbers(str);
+    }
     str += '$';
     ST.push(pair<int, char>(0, '-'));
 }
-/* 分析程序 */
-void process()
+/* 按产生式p规约：弹出pop个符号并输出产生式，再按goto表转移 */
+void reduceBy(int p, int pop)
+{
+    Production &P = grammar.prods[p];
+    /* 弹出并输出产生式 */
+    if (!quiet) {
+        printf("%c->", P.left);
+        for (int i = 0; i < P.rigths.size(); i++) {
+            printf("%c", P.rigths[i]);
+        }
+        printf("\n");
+    }
+    for (int i = 0; i < pop; i++) {
+        ST.pop();
+    }
+    /* 移进-规约合并时移进的符号已经压入了值栈，按右部全长弹出 */
+    if (eval) {
+        values.reduce(p, P.rigths.size());
+    }
+    int s = ST.top().first;
+    int j = isInN(P.left) - 1;
+    if (profiling) {
+        prodHits[p]++;
+        nontermHits[j]++;
+    }
+    /* 输出优化时跳过的单产生式规约 */
+    vector<int> &chain = table.gotoChain[s][j];
+    for (int k = 0; k < chain.size(); k++) {
+        Production &U = grammar.prods[chain[k]];
+        if (profiling) {
+            prodHits[chain[k]]++;
+        }
+        if (!quiet) {
+            printf("%c->%c\n", U.left, U.rigths[0]);
+        }
+        if (eval) {
+            values.reduce(chain[k], 1);
+        }
+    }
+    savedSteps += chain.size();
+    ST.push(pair<int, char>(table.goton[s][j], chain.empty() ? P.left : grammar.prods[chain.back()].left));
+}
+/* 分析程序，接受时返回true，quiet时遇到错误返回false */
+bool process()
 {
     int ip = 0;
-    printf("The ans:\n");
+    steps = 0;
+    savedSteps = 0;
+    if (!quiet) {
+        printf("The ans:\n");
+    }
     do {
+        steps++;
         int s = ST.top().first;
+        if (profiling) {
+            stateHits[s]++;
+        }
+        /* 默认规约不必查看向前看符号 */
+        if (optimize && table.defaultReduce[s] >= 0) {
+            int p = table.defaultReduce[s];
+            TRACE_EVENT(TRACE_REDUCE, s, ip, p);
+            reduceBy(p, grammar.prods[p].rigths.size());
+            TRACE_EVENT(TRACE_GOTO, ST.top().first, ip, ST.top().second);
+            continue;
+        }
         char a = str[ip];
         int j = isInT(a) - 1;
+        if (quiet && j < 0) {
+            TRACE_EVENT(TRACE_ERROR, s, ip, a);
+            return false;
+        }
+        if (profiling) {
+            termHits[j]++;
+        }
         /* 移进 */
-        if (action[s][j].first == 1) {
-            ST.push(pair<int, char>(action[s][j].second, a));
+        if (table.action[s][j].first == 1) {
+            TRACE_EVENT(TRACE_SHIFT, s, ip, table.action[s][j].second);
+            ST.push(pair<int, char>(table.action[s][j].second, a));
+            if (eval) {
+                values.shift(ip);
+            }
+            ip = ip + 1;
+        } else if (table.action[s][j].first == 2) { // 规约
+            int p = table.action[s][j].second;
+            TRACE_EVENT(TRACE_REDUCE, s, ip, p);
+            reduceBy(p, grammar.prods[p].rigths.size());
+            TRACE_EVENT(TRACE_GOTO, ST.top().first, ip, ST.top().second);
+        } else if (table.action[s][j].first == 4) { // 移进后立即规约，移进的符号不必入栈
+            int p = table.action[s][j].second;
+            if (eval) {
+                values.shift(ip);
+            }
             ip = ip + 1;
-        } else if (action[s][j].first == 2) { // 规约
-            Production &P = grammar.prods[action[s][j].second];
-            /* 弹出并输出产生式 */
-            printf("%c->", P.left);
-            for (int i = 0; i < P.rigths.size(); i++) {
-                ST.pop();
-                printf("%c", P.rigths[i]);
+            savedSteps++;
+            TRACE_EVENT(TRACE_REDUCE, s, ip, p);
+            reduceBy(p, grammar.prods[p].rigths.size() - 1);
+            TRACE_EVENT(TRACE_GOTO, ST.top().first, ip, ST.top().second);
+        } else if (table.action[s][j].first == 3) {   //接受
+            TRACE_EVENT(TRACE_ACCEPT, s, ip, 0);
+            if (quiet) {
+                return true;
             }
-            printf("\n");
-            s = ST.top().first;
-            char A = P.left;
-            j = isInN(A) - 1;
-            ST.push(pair<int, char>(goton[s][j], A));
-        } else if (action[s][j].first == 3) {   //接受
             printf("ACC\n");
-            return;
+            if (eval) {
+                printf("value: %g\n", values.top());
+            }
+            if (optimize) {
+                int tokens = str.size();
+                printf("steps: %d (unoptimized %d), %.2f -> %.2f steps per token\n", steps, steps + savedSteps,
+                       (double)(steps + savedSteps) / tokens, (double)steps / tokens);
+            }
+            if (trace) {
+                printTrace();
+            }
+            return true;
         } else {
+            TRACE_EVENT(TRACE_ERROR, s, ip, a);
+            if (quiet) {
+                return false;
+            }
             printf("error\n");
+            /* 第一次出错时输出跟踪 */
+            if (trace) {
+                printTrace();
+                trace = false;
+            }
         }
     } while(1);
 }
-int main()
+
+/* 清空分析栈，只留下初始状态 */
+void resetStack()
+{
+    while (!ST.empty()) {
+        ST.pop();
+    }
+    ST.push(pair<int, char>(0, '-'));
+}
+
+/* 不输出地依次分析语料中的每个串，返回接受的串数 */
+int runCorpus(vector<string> &corpus)
+{
+    int accepted = 0;
+    for (int k = 0; k < corpus.size(); k++) {
+        str = corpus[k];
+        resetStack();
+        if (process()) {
+            accepted++;
+        }
+    }
+    return accepted;
+}
+
+/* 反复分析语料至少0.2秒，返回每秒分析的符号数 */
+double throughput(vector<string> &corpus)
 {
+    long long symbols = 0;
+    for (int k = 0; k < corpus.size(); k++) {
+        symbols += corpus[k].size();
+    }
+    runCorpus(corpus);
+    long long rounds = 0;
+    double elapsed = 0;
+    auto begin = chrono::steady_clock::now();
+    while (elapsed < 0.2) {
+        runCorpus(corpus);
+        rounds++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    }
+    return symbols * rounds / elapsed;
+}
+
+/* 用训练语料统计使用次数并重新编号，比较重新编号前后分析留出语料的速度 */
+void profileTables()
+{
+    vector<string> train, heldout;
+    if (!readCorpus(trainFile, train) || !readCorpus(heldoutFile, heldout)) {
+        printf("cannot read corpus %s %s\n", trainFile.c_str(), heldoutFile.c_str());
+        return;
+    }
+    /* 语料中的串按符号分析，不计算值 */
+    bool e = eval;
+    eval = false;
+    quiet = true;
+    double before = throughput(heldout);
+    stateHits.assign(CC.items.size(), 0);
+    termHits.assign(grammar.T.size(), 0);
+    nontermHits.assign(grammar.N.size(), 0);
+    prodHits.assign(grammar.prods.size(), 0);
+    profiling = true;
+    int accepted = runCorpus(train);
+    profiling = false;
+    table.renumberByProfile(grammar, CC, arena, stateHits, termHits, nontermHits, prodHits);
+    double after = throughput(heldout);
+    quiet = false;
+    eval = e;
+    while (!ST.empty()) {
+        ST.pop();
+    }
+    printf("profile: %d of %d training inputs accepted, %d held-out inputs\n", accepted, (int)train.size(), (int)heldout.size());
+    printf("profile: %.1f -> %.1f M symbols/s (%.2fx)\n", before / 1e6, after / 1e6, after / before);
+}
+
+/* 不输出地分析语料中的一个串，--latency计时用 */
+bool parseCorpusLine(const string &s)
+{
+    str = s;
+    resetStack();
+    return process();
+}
+
+/* GLR模式 */
+bool glr = false;
+
+int main(int argc, char *argv[])
+{
+    /* --glr 使用GLR分析程序，--optimize 优化分析表，--eval 输入串中可以写数字，分析的同时执行语义动作计算值，
+     * --profile TRAIN HELDOUT 按训练语料中的使用次数重新编号并比较留出语料的分析速度，
+     * --latency CORPUS JSON 把语料中每个串的分析延迟写成JSON，--trace 输出编译时打开的分析跟踪 */
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--glr") {
+            glr = true;
+        } else if (string(argv[i]) == "--optimize") {
+            optimize = true;
+        } else if (string(argv[i]) == "--eval") {
+            eval = true;
+            values.registerArithmetic();
+        } else if (string(argv[i]) == "--profile" && i + 2 < argc) {
+            trainFile = argv[i + 1];
+            heldoutFile = argv[i + 2];
+            i += 2;
+        } else if (string(argv[i]) == "--latency" && i + 2 < argc) {
+            latencyCorpus = argv[i + 1];
+            latencyJson = argv[i + 2];
+            i += 2;
+        } else if (string(argv[i]) == "--trace") {
+            trace = true;
+        }
+    }
+    /* GLR分析程序不处理优化后的动作和被跳过的单产生式规约，不优化分析表 */
+    if (glr) {
+        optimize = false;
+    }
     initGrammar();
-    process();
+    if (glr) {
+        GLRParser<Grammar>(grammar, table).parse(str);
+    } else {
+        process();
+    }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <ctime>
+#include <algorithm>
+#include <thread>
+#include "parser.h"
+using namespace std;
+
+/* 语法分析库的性能测试，每种测试同时检查结果与Parser的完整分析相同 */
+
+/* 读入"LL1/SLR1/LR1:文件名"指定的文法，构建分析表，文件中文法之后的串作为输入 */
+shared_ptr<const ParseTable> loadTable(const string &spec, string &input)
+{
+    size_t colon = spec.find(':');
+    if (colon == string::npos)
+        return shared_ptr<const ParseTable>();
+    string engine = spec.substr(0, colon);
+    Engine e;
+    if (engine == "LL1") {
+        e = ENGINE_LL1;
+    } else if (engine == "SLR1") {
+        e = ENGINE_SLR1;
+    } else if (engine == "LR1") {
+        e = ENGINE_LR1;
+    } else {
+        return shared_ptr<const ParseTable>();
+    }
+    ifstream in(spec.substr(colon + 1).c_str());
+    Grammar g;
+    if (!readGrammar(in, g) || !(in >> input))
+        return shared_ptr<const ParseTable>();
+    return buildParseTable(g, e);
+}
+
+/* 把输入串重复count次，中间用sep连接 */
+string repeatInput(const string &s, int count, const string &sep)
+{
+    string out = s;
+    for (int i = 1; i < count; i++) {
+        out += sep;
+        out += s;
+    }
+    return out;
+}
+
+double elapsedUs(chrono::steady_clock::time_point begin)
+{
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count();
+}
+
+/* edit ENGINE:FILE REPEAT [SEP]：每次把一个随机位置的符号换成另一个终结符，再改回来，
+ * 比较增量分析与完整分析的延迟 */
+int benchEdit(const string &spec, int repeat, const string &sep)
+{
+    string s;
+    shared_ptr<const ParseTable> t = loadTable(spec, s);
+    if (!t) {
+        fprintf(stderr, "cannot load grammar %s\n", spec.c_str());
+        return 1;
+    }
+    string input = repeatInput(s, repeat, sep);
+    IncrementalParser inc(t);
+    Parser full(t);
+    vector<int> d;
+    if (!inc.parse(input)) {
+        fprintf(stderr, "input is not accepted\n");
+        return 1;
+    }
+    const int edits = 200;
+    double incUs = 0, fullUs = 0;
+    long long reparsed = 0;
+    int wrong = 0;
+    srand(1);
+    for (int i = 0; i < edits; i++) {
+        int pos = rand() % input.size();
+        string to(1, t->T[rand() % (t->T.size() - 1)]);
+        string back(1, input[pos]);
+        for (int k = 0; k < 2; k++) {
+            auto begin = chrono::steady_clock::now();
+            bool ok = inc.edit(pos, 1, k == 0 ? to : back);
+            incUs += elapsedUs(begin);
+            reparsed += inc.reparsed;
+            begin = chrono::steady_clock::now();
+            bool ok2 = full.parse(inc.input, d);
+            fullUs += elapsedUs(begin);
+            if (ok != ok2 || (ok && d != inc.derivation))
+                wrong++;
+        }
+    }
+    printf("input: %d symbols, %d edits\n", (int)input.size(), 2 * edits);
+    printf("incremental: %.1f us per edit, %.1f symbols reparsed\n", incUs / (2 * edits), (double)reparsed / (2 * edits));
+    printf("full:        %.1f us per edit (%.1fx)\n", fullUs / (2 * edits), fullUs / incUs);
+    printf("mismatches:  %d\n", wrong);
+    return wrong != 0;
+}
+
+/* parallel ENGINE:FILE REPEAT [SEP]：比较不同线程数的并行分析与顺序分析 */
+int benchParallel(const string &spec, int repeat, const string &sep)
+{
+    string s;
+    shared_ptr<const ParseTable> t = loadTable(spec, s);
+    if (!t) {
+        fprintf(stderr, "cannot load grammar %s\n", spec.c_str());
+        return 1;
+    }
+    string input = repeatInput(s, repeat, sep);
+    Parser p(t);
+    vector<int> d, pd;
+    auto begin = chrono::steady_clock::now();
+    clock_t cpu = clock();
+    bool ok = p.parse(input, d);
+    double seqCpuUs = (double)(clock() - cpu) * 1e6 / CLOCKS_PER_SEC;
+    double seqUs = elapsedUs(begin);
+    printf("input: %d symbols, %s\n", (int)input.size(), ok ? "accepted" : "rejected");
+    printf("sequential:  wall %.1f ms, cpu %.1f ms\n", seqUs / 1000, seqCpuUs / 1000);
+    int wrong = 0;
+    /* wall为本机上的实际耗时，与顺序分析的wall比较；critical为各阶段所在线程的CPU时间按每块一个核
+     * 算出的耗时，与顺序分析的cpu比较。核数少于线程数时各块只能轮流执行，wall不能反映多核上的耗时 */
+    printf("cores: %u\n", thread::hardware_concurrency());
+    for (int threads = 2; threads <= 16; threads *= 2) {
+        ParallelStats stats;
+        begin = chrono::steady_clock::now();
+        bool ok2 = parseParallel(t, input, pd, threads, &stats);
+        double us = elapsedUs(begin);
+        bool same = ok == ok2 && (!ok || d == pd);
+        if (!same)
+            wrong++;
+        double crit = stats.criticalUs();
+        double chunk = *max_element(stats.chunkUs.begin(), stats.chunkUs.end());
+        printf("%2d threads:  wall %.1f ms (%.2fx), critical path %.1f ms (%.2fx; sample %.1f, chunk %.1f, splice %.1f), "
+               "%d/%d chunks speculated correctly, %s\n", threads, us / 1000, seqUs / us, crit / 1000, seqCpuUs / crit,
+               stats.sampleUs / 1000, chunk / 1000, stats.spliceUs / 1000, stats.hits, threads - 1,
+               same ? "same result" : "MISMATCH");
+    }
+    return wrong != 0;
+}
+
+int main(int argc, char *argv[])
+{
+    string mode = argc > 1 ? argv[1] : "";
+    if (mode == "edit" && argc >= 4)
+        return benchEdit(argv[2], atoi(argv[3]), argc > 4 ? argv[4] : "");
+    if (mode == "parallel" && argc >= 4)
+        return benchParallel(argv[2], atoi(argv[3]), argc > 4 ? argv[4] : "");
+    fprintf(stderr, "usage:\n"
+            "  %s edit ENGINE:FILE REPEAT [SEP]\n"
+            "  %s parallel ENGINE:FILE REPEAT [SEP]\n"
+            "ENGINE is LL1, SLR1 or LR1; the input is the string after the grammar in FILE,\n"
+            "repeated REPEAT times and joined by SEP\n", argv[0], argv[0]);
+    return 1;
+}
@@ -0,0 +1,446 @@
+#ifndef CTPARSER_H
+#define CTPARSER_H
+
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/* 编译期构建SLR1/LR1分析表(需要C++17)。文法写成一个类型，其中的constexpr字符串给出产生式，
+ * 例如"A->E E->E+T E->T T->T*F T->F F->(E) F->n"：产生式之间用空白分隔，第一个产生式为拓广文法的
+ * 开始产生式，所有左部符号为非终结符，其余符号为终结符，&表示空。
+ * FIRST集、FOLLOW集、项目集规范族和分析表全部在编译期求出，分析表是constexpr数组，
+ * 分析程序按各个文法分别实例化，程序启动时不做任何构建 */
+
+namespace ct {
+
+enum Engine {
+    SLR1,
+    LR1
+};
+
+/* 编译期构建的容量上限，超出时build()报告error */
+constexpr int MAXP = 64;            // 产生式数
+constexpr int MAXRHS = 15;          // 右部长度
+constexpr int MAXT = 64;            // 终结符数(含$)，FIRST集用64位掩码表示
+constexpr int MAXN = 64;            // 非终结符数
+constexpr int MAXSTATES = 256;      // 状态数
+constexpr int MAXKERNEL = 16;       // 每个状态核心项目数
+constexpr int MAXCLOSURE = 128;     // 每个状态闭包项目数
+
+/* 读入的文法 */
+struct Spec {
+    int np = 0;
+    char left[MAXP] = {};
+    char rhs[MAXP][MAXRHS] = {};
+    int len[MAXP] = {};
+    int leftIndex[MAXP] = {};       // 左部在nonterm中的下标
+    int nt = 0;
+    char term[MAXT] = {};           // 最后一个为$
+    int nn = 0;
+    char nonterm[MAXN] = {};
+    int termIndex[256] = {};        // -1表示不是终结符
+    int nontermIndex[256] = {};     // -1表示不是非终结符
+    bool error = false;
+};
+
+/* LR项目，core = 产生式序号 * (MAXRHS + 1) + 点的位置；同一核心的向前看符号合并成掩码，SLR1中为0 */
+struct Item {
+    int core = 0;
+    uint64_t la = 0;
+};
+
+struct Kernel {
+    int n = 0;
+    Item items[MAXKERNEL] = {};
+};
+
+struct Closure {
+    int n = 0;
+    Item items[MAXCLOSURE] = {};
+};
+
+/* 构建结果，容量按上限分配，只在编译期使用 */
+struct Tables {
+    Spec g;
+    uint64_t first[MAXN] = {};
+    bool nullable[MAXN] = {};
+    uint64_t follow[MAXN] = {};
+    int nstates = 0;
+    Kernel kernels[MAXSTATES] = {};
+    /* 分析动作：0->出错 (s<<2)|1->移进到状态s (p<<2)|2->按产生式p规约 3->接受 */
+    int action[MAXSTATES][MAXT] = {};
+    int go[MAXSTATES][MAXN] = {};
+    int conflicts = 0;
+    bool error = false;
+};
+
+constexpr bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/* 读入文法字符串 */
+constexpr Spec parseSpec(std::string_view s)
+{
+    Spec g;
+    for (int i = 0; i < 256; i++) {
+        g.termIndex[i] = -1;
+        g.nontermIndex[i] = -1;
+    }
+    size_t i = 0;
+    while (true) {
+        while (i < s.size() && isSpace(s[i])) {
+            i++;
+        }
+        if (i == s.size())
+            break;
+        if (g.np == MAXP || i + 3 > s.size() || s[i + 1] != '-' || s[i + 2] != '>') {
+            g.error = true;
+            return g;
+        }
+        g.left[g.np] = s[i];
+        int k = 0;
+        for (i += 3; i < s.size() && !isSpace(s[i]); i++) {
+            if (s[i] == '&')
+                continue;
+            if (k == MAXRHS) {
+                g.error = true;
+                return g;
+            }
+            g.rhs[g.np][k++] = s[i];
+        }
+        g.len[g.np++] = k;
+    }
+    for (int p = 0; p < g.np; p++) {
+        unsigned char A = g.left[p];
+        if (g.nontermIndex[A] < 0) {
+            if (g.nn == MAXN) {
+                g.error = true;
+                return g;
+            }
+            g.nontermIndex[A] = g.nn;
+            g.nonterm[g.nn++] = A;
+        }
+        g.leftIndex[p] = g.nontermIndex[A];
+    }
+    for (int p = 0; p < g.np; p++) {
+        for (int k = 0; k < g.len[p]; k++) {
+            unsigned char X = g.rhs[p][k];
+            if (g.nontermIndex[X] < 0 && g.termIndex[X] < 0) {
+                if (g.nt == MAXT - 1) {
+                    g.error = true;
+                    return g;
+                }
+                g.termIndex[X] = g.nt;
+                g.term[g.nt++] = X;
+            }
+        }
+    }
+    g.termIndex[(unsigned char)'$'] = g.nt;
+    g.term[g.nt++] = '$';
+    g.error = g.error || g.np == 0;
+    return g;
+}
+
+/* 产生式p右部从第k个符号开始的后缀的FIRST集，nullable返回后缀能否推空 */
+constexpr uint64_t firstOfSuffix(const Tables &t, int p, int k, bool &nullable)
+{
+    uint64_t mask = 0;
+    for (; k < t.g.len[p]; k++) {
+        unsigned char X = t.g.rhs[p][k];
+        if (t.g.termIndex[X] >= 0) {
+            nullable = false;
+            return mask | (uint64_t(1) << t.g.termIndex[X]);
+        }
+        int b = t.g.nontermIndex[X];
+        mask |= t.first[b];
+        if (!t.nullable[b]) {
+            nullable = false;
+            return mask;
+        }
+    }
+    nullable = true;
+    return mask;
+}
+
+constexpr void getFirstFollow(Tables &t)
+{
+    bool change = true;
+    while (change) {
+        change = false;
+        for (int p = 0; p < t.g.np; p++) {
+            int A = t.g.leftIndex[p];
+            bool n = false;
+            uint64_t f = t.first[A] | firstOfSuffix(t, p, 0, n);
+            if (f != t.first[A] || (n && !t.nullable[A])) {
+                t.first[A] = f;
+                t.nullable[A] = t.nullable[A] || n;
+                change = true;
+            }
+        }
+    }
+    t.follow[0] = uint64_t(1) << (t.g.nt - 1);
+    change = true;
+    while (change) {
+        change = false;
+        for (int p = 0; p < t.g.np; p++) {
+            for (int k = 0; k < t.g.len[p]; k++) {
+                int B = t.g.nontermIndex[(unsigned char)t.g.rhs[p][k]];
+                if (B < 0)
+                    continue;
+                bool n = false;
+                uint64_t f = t.follow[B] | firstOfSuffix(t, p, k + 1, n);
+                if (n)
+                    f |= t.follow[t.g.leftIndex[p]];
+                if (f != t.follow[B]) {
+                    t.follow[B] = f;
+                    change = true;
+                }
+            }
+        }
+    }
+}
+
+/* 按核心有序地加入项目，核心已存在时合并向前看符号，项目集变化时返回true */
+template <class Set>
+constexpr bool addItem(Set &S, int capacity, int core, uint64_t la, bool &error)
+{
+    int i = 0;
+    while (i < S.n && S.items[i].core < core) {
+        i++;
+    }
+    if (i < S.n && S.items[i].core == core) {
+        if ((S.items[i].la | la) == S.items[i].la)
+            return false;
+        S.items[i].la |= la;
+        return true;
+    }
+    if (S.n == capacity) {
+        error = true;
+        return false;
+    }
+    for (int k = S.n; k > i; k--) {
+        S.items[k] = S.items[k - 1];
+    }
+    S.items[i].core = core;
+    S.items[i].la = la;
+    S.n++;
+    return true;
+}
+
+constexpr void closure(Tables &t, Closure &C, bool lr1)
+{
+    bool change = true;
+    while (change && !t.error) {
+        change = false;
+        for (int i = 0; i < C.n; i++) {
+            int p = C.items[i].core / (MAXRHS + 1);
+            int dot = C.items[i].core % (MAXRHS + 1);
+            if (dot == t.g.len[p])
+                continue;
+            unsigned char B = t.g.rhs[p][dot];
+            if (t.g.nontermIndex[B] < 0)
+                continue;
+            /* 新项目的向前看符号为FIRST(βa) */
+            uint64_t la = 0;
+            if (lr1) {
+                bool n = false;
+                la = firstOfSuffix(t, p, dot + 1, n);
+                if (n)
+                    la |= C.items[i].la;
+            }
+            for (int q = 0; q < t.g.np; q++) {
+                if (t.g.left[q] == B && addItem(C, MAXCLOSURE, q * (MAXRHS + 1), la, t.error))
+                    change = true;
+            }
+        }
+    }
+}
+
+constexpr bool sameKernel(const Kernel &a, const Kernel &b)
+{
+    if (a.n != b.n)
+        return false;
+    for (int i = 0; i < a.n; i++) {
+        if (a.items[i].core != b.items[i].core || a.items[i].la != b.items[i].la)
+            return false;
+    }
+    return true;
+}
+
+/* 填写action表，冲突时保留先填入的动作 */
+constexpr void setAction(Tables &t, int s, int j, int act)
+{
+    if (t.action[s][j] != 0 && t.action[s][j] != act) {
+        t.conflicts++;
+        return;
+    }
+    t.action[s][j] = act;
+}
+
+/* 构建SLR1或LR1分析表 */
+constexpr Tables build(std::string_view grammar, Engine engine)
+{
+    Tables t;
+    t.g = parseSpec(grammar);
+    if (t.g.error) {
+        t.error = true;
+        return t;
+    }
+    bool lr1 = engine == LR1;
+    getFirstFollow(t);
+    t.kernels[0].n = 1;
+    t.kernels[0].items[0].core = 0;
+    t.kernels[0].items[0].la = lr1 ? uint64_t(1) << (t.g.nt - 1) : 0;
+    t.nstates = 1;
+    for (int s = 0; s < t.nstates && !t.error; s++) {
+        for (int j = 0; j < MAXN; j++) {
+            t.go[s][j] = -1;
+        }
+        Closure C;
+        for (int i = 0; i < t.kernels[s].n; i++) {
+            C.items[i] = t.kernels[s].items[i];
+        }
+        C.n = t.kernels[s].n;
+        closure(t, C, lr1);
+        /* 先按终结符再按非终结符求转移 */
+        for (int x = 0; x < t.g.nt + t.g.nn && !t.error; x++) {
+            char X = x < t.g.nt ? t.g.term[x] : t.g.nonterm[x - t.g.nt];
+            Kernel K;
+            for (int i = 0; i < C.n; i++) {
+                int p = C.items[i].core / (MAXRHS + 1);
+                int dot = C.items[i].core % (MAXRHS + 1);
+                if (dot < t.g.len[p] && t.g.rhs[p][dot] == X)
+                    addItem(K, MAXKERNEL, C.items[i].core + 1, C.items[i].la, t.error);
+            }
+            if (K.n == 0)
+                continue;
+            int to = 0;
+            while (to < t.nstates && !sameKernel(t.kernels[to], K)) {
+                to++;
+            }
+            if (to == t.nstates) {
+                if (t.nstates == MAXSTATES) {
+                    t.error = true;
+                    break;
+                }
+                t.kernels[t.nstates++] = K;
+            }
+            if (x < t.g.nt) {
+                setAction(t, s, x, (to << 2) | 1);
+            } else {
+                t.go[s][x - t.g.nt] = to;
+            }
+        }
+        /* 规约项目 */
+        for (int i = 0; i < C.n; i++) {
+            int p = C.items[i].core / (MAXRHS + 1);
+            int dot = C.items[i].core % (MAXRHS + 1);
+            if (dot < t.g.len[p])
+                continue;
+            if (p == 0) {
+                setAction(t, s, t.g.nt - 1, 3);
+                continue;
+            }
+            uint64_t la = lr1 ? C.items[i].la : t.follow[t.g.leftIndex[p]];
+            for (int j = 0; j < t.g.nt; j++) {
+                if (la >> j & 1)
+                    setAction(t, s, j, (p << 2) | 2);
+            }
+        }
+    }
+    return t;
+}
+
+/* 按实际大小保存的分析表，程序中只保存这一部分 */
+template <int S, int T, int N, int P>
+struct Table {
+    int action[S][T] = {};
+    int go[S][N] = {};
+    int len[P] = {};
+    int leftIndex[P] = {};
+    int termIndex[256] = {};
+    int conflicts = 0;
+};
+
+template <int S, int T, int N, int P>
+constexpr Table<S, T, N, P> compact(const Tables &t)
+{
+    Table<S, T, N, P> r;
+    for (int s = 0; s < S; s++) {
+        for (int j = 0; j < T; j++) {
+            r.action[s][j] = t.action[s][j];
+        }
+        for (int j = 0; j < N; j++) {
+            r.go[s][j] = t.go[s][j];
+        }
+    }
+    for (int p = 0; p < P; p++) {
+        r.len[p] = t.g.len[p];
+        r.leftIndex[p] = t.g.leftIndex[p];
+    }
+    for (int i = 0; i < 256; i++) {
+        r.termIndex[i] = t.g.termIndex[i];
+    }
+    r.conflicts = t.conflicts;
+    return r;
+}
+
+/* G中声明static constexpr bool keepConflicts = true时允许有冲突(保留先填入的动作)，默认不允许 */
+template <class G, class = void>
+struct KeepConflicts {
+    static constexpr bool value = false;
+};
+
+template <class G>
+struct KeepConflicts<G, std::void_t<decltype(G::keepConflicts)>> {
+    static constexpr bool value = G::keepConflicts;
+};
+
+/* 文法G的分析程序，G中给出static constexpr const char *grammar和static constexpr Engine engine，
+ * 在所选方法下有冲突时编译报错，除非G声明了keepConflicts */
+template <class G>
+struct Parser {
+    static constexpr Tables built = build(G::grammar, G::engine);
+    static_assert(!built.error, "grammar is malformed or exceeds the compile-time limits in ctparser.h");
+    static_assert(built.conflicts == 0 || KeepConflicts<G>::value,
+                  "grammar has conflicts under the chosen engine; declare keepConflicts = true to keep the first action");
+    static constexpr Table<built.nstates, built.g.nt, built.g.nn, built.g.np> table =
+        compact<built.nstates, built.g.nt, built.g.nn, built.g.np>(built);
+
+    /* 分析input(不含$)，接受时返回true；derivation不为空时保存最右推导逆序的产生式序号 */
+    static bool parse(std::string_view input, std::vector<int> *derivation = nullptr)
+    {
+        std::vector<int> st;
+        st.reserve(input.size() + 1);
+        st.push_back(0);
+        size_t ip = 0;
+        while (true) {
+            char a = ip < input.size() ? input[ip] : '$';
+            int j = table.termIndex[(unsigned char)a];
+            if (j < 0 || (a == '$' && ip < input.size()))
+                return false;
+            int act = table.action[st.back()][j];
+            if ((act & 3) == 1) {   // 移进
+                st.push_back(act >> 2);
+                ip++;
+            } else if ((act & 3) == 2) {    // 规约
+                int p = act >> 2;
+                st.resize(st.size() - table.len[p]);
+                int to = table.go[st.back()][table.leftIndex[p]];
+                if (to < 0)
+                    return false;
+                st.push_back(to);
+                if (derivation)
+                    derivation->push_back(p);
+            } else {
+                return act == 3;
+            }
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,305 @@
+#ifndef GLR_H
+#define GLR_H
+
+#include <cstdio>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "lrtable.h"
+
+/* SLR1、LR1两个分析程序共用的GLR分析程序。Grammar需要有T、N和prods，产生式需要有char left和vector<char> rigths */
+
+/* 共享压缩分析森林(SPPF)的结点，表示symbol推出输入串的[start, end)部分 */
+struct SppfNode {
+    char symbol;
+    int start;
+    int end;
+    /* 每一种推导方式(打包结点)：first为产生式序号，second为孩子结点 */
+    std::vector< std::pair<int, std::vector<int> > > packs;
+};
+
+/* 图结构栈(GSS)的结点 */
+struct GssNode {
+    int state;
+    /* 出边，first为栈中下面的结点，second为边上对应的SPPF结点 */
+    std::vector< std::pair<int, int> > edges;
+};
+
+/* GLR待执行的规约：结点v，产生式p，edge>=0时路径的第一条边固定为v的第edge条边 */
+struct Reduction {
+    int v;
+    int p;
+    int edge;
+};
+
+/* 推导数目为无穷：单产生式构成环(如A->B B->A)时森林中有环 */
+const unsigned long long CYCLIC = ~0ULL;
+
+/* GLR分析程序：有冲突的表项保留全部动作，用图结构栈同时维护多个分析栈，
+ * 分析结果保存在共享压缩分析森林中。只有一个栈顶且表项无冲突时按普通LR直接规约 */
+template <class Grammar>
+struct GLRParser {
+    const Grammar &grammar;
+    const LRTable &table;
+    std::vector<SppfNode> sppf;
+    std::vector<GssNode> gss;
+    /* 当前层中(符号, 起始位置)到SPPF结点的映射，保证同一个符号串只有一个结点 */
+    std::map< std::pair<char, int>, int > levelSppf;
+
+    GLRParser(const Grammar &g, const LRTable &t) : grammar(g), table(t) {}
+
+    /* 新建GSS结点 */
+    int newGssNode(int state)
+    {
+        GssNode n;
+        n.state = state;
+        gss.push_back(n);
+        return gss.size() - 1;
+    }
+
+    /* 查找或新建当前层表示symbol推出[start, end)的SPPF结点 */
+    int getSppfNode(char symbol, int start, int end)
+    {
+        auto it = levelSppf.find(std::pair<char, int>(symbol, start));
+        if (it != levelSppf.end())
+            return it->second;
+        SppfNode n;
+        n.symbol = symbol;
+        n.start = start;
+        n.end = end;
+        sppf.push_back(n);
+        levelSppf[std::pair<char, int>(symbol, start)] = sppf.size() - 1;
+        return sppf.size() - 1;
+    }
+
+    /* 从结点v出发沿长度为len的路径向下走，把每条路径的终点和路径上的SPPF结点(从左到右)加入paths */
+    void findPaths(int v, int len, int edge, std::vector<int> &children,
+                   std::vector< std::pair<int, std::vector<int> > > &paths)
+    {
+        if (len == 0) {
+            paths.push_back(std::pair<int, std::vector<int> >(v, std::vector<int>(children.rbegin(), children.rend())));
+            return;
+        }
+        for (int e = 0; e < gss[v].edges.size(); e++) {
+            if (edge >= 0 && e != edge)
+                continue;
+            children.push_back(gss[v].edges[e].second);
+            findPaths(gss[v].edges[e].first, len - 1, -1, children, paths);
+            children.pop_back();
+        }
+    }
+
+    /* 把产生式p规约得到的左部接到结点u上(孩子为children，当前位置为ip)，
+     * 返回当前层状态为goto(u, A)的结点，newNode表示结点是否新建，newEdge为新加的边的下标(-1表示边已存在) */
+    int gssReduce(int u, int p, std::vector<int> &children, int ip, std::vector<int> &frontier, bool &newNode,
+                  int &newEdge)
+    {
+        char A = grammar.prods[p].left;
+        int start = children.empty() ? ip : sppf[children[0]].start;
+        int z = getSppfNode(A, start, ip);
+        /* 同一种推导只记录一次 */
+        std::pair<int, std::vector<int> > pack(p, children);
+        if (std::find(sppf[z].packs.begin(), sppf[z].packs.end(), pack) == sppf[z].packs.end()) {
+            sppf[z].packs.push_back(pack);
+        }
+        int k = table.goton[gss[u].state][symbolIndex(grammar.N, A) - 1];
+        newNode = false;
+        newEdge = -1;
+        int w = -1;
+        for (int i = 0; i < frontier.size(); i++) {
+            if (gss[frontier[i]].state == k) {
+                w = frontier[i];
+                break;
+            }
+        }
+        if (w < 0) {
+            w = newGssNode(k);
+            frontier.push_back(w);
+            newNode = true;
+        }
+        for (int e = 0; e < gss[w].edges.size(); e++) {
+            if (gss[w].edges[e].first == u)
+                return w;
+        }
+        gss[w].edges.push_back(std::pair<int, int>(u, z));
+        newEdge = gss[w].edges.size() - 1;
+        return w;
+    }
+
+    /* 统计以结点z为根的推导数目，超过上限时不再累加。
+     * 进入结点时先在memo中记为CYCLIC，未算完又回到该结点说明森林有环，结果为CYCLIC */
+    unsigned long long countDerivations(int z, std::map<int, unsigned long long> &memo)
+    {
+        if (sppf[z].packs.empty())
+            return 1;
+        auto it = memo.find(z);
+        if (it != memo.end())
+            return it->second;
+        memo[z] = CYCLIC;
+        const unsigned long long LIMIT = 1000000000000ULL;
+        unsigned long long total = 0;
+        for (int i = 0; i < sppf[z].packs.size(); i++) {
+            unsigned long long cnt = 1;
+            std::vector<int> &ch = sppf[z].packs[i].second;
+            for (int c = 0; c < ch.size(); c++) {
+                unsigned long long sub = countDerivations(ch[c], memo);
+                if (sub == CYCLIC)
+                    return CYCLIC;
+                cnt = std::min(LIMIT, cnt * sub);
+            }
+            total = std::min(LIMIT, total + cnt);
+        }
+        memo[z] = total;
+        return total;
+    }
+
+    /* 按第一种推导后序输出所用的产生式，即最右推导的逆序列。
+     * active标记正在输出的结点，遇到环时返回false */
+    bool printDerivation(int z, std::vector<char> &active)
+    {
+        if (sppf[z].packs.empty())
+            return true;
+        if (active[z])
+            return false;
+        active[z] = 1;
+        std::pair<int, std::vector<int> > &pack = sppf[z].packs[0];
+        for (int c = 0; c < pack.second.size(); c++) {
+            if (!printDerivation(pack.second[c], active))
+                return false;
+        }
+        active[z] = 0;
+        const std::vector<char> &R = grammar.prods[pack.first].rigths;
+        printf("%c->%s\n", grammar.prods[pack.first].left, std::string(R.begin(), R.end()).c_str());
+        return true;
+    }
+
+    /* 分析str(以$结尾)，输出第一种推导以及森林的结点数和推导数目 */
+    void parse(const std::string &str)
+    {
+        gss.clear();
+        sppf.clear();
+        std::vector<int> frontier(1, newGssNode(0));
+        printf("The ans:\n");
+        for (int ip = 0; ip < str.size(); ip++) {
+            char a = str[ip];
+            int j = symbolIndex(grammar.T, a) - 1;
+            if (j < 0) {
+                printf("error\n");
+                return;
+            }
+            levelSppf.clear();
+            /* 无冲突的区域：唯一的栈顶，唯一的规约动作，且路径唯一 */
+            while (frontier.size() == 1) {
+                int v = frontier[0];
+                const std::vector< std::pair<int, int> > &acts = table.actions[gss[v].state][j];
+                if (acts.size() != 1 || acts[0].first != 2)
+                    break;
+                int p = acts[0].second;
+                std::vector<int> children;
+                int u = v;
+                for (int len = grammar.prods[p].rigths.size(); len > 0 && gss[u].edges.size() == 1; len--) {
+                    children.push_back(gss[u].edges[0].second);
+                    u = gss[u].edges[0].first;
+                }
+                if (children.size() != grammar.prods[p].rigths.size())
+                    break;
+                std::reverse(children.begin(), children.end());
+                frontier.clear();
+                bool newNode;
+                int newEdge;
+                gssReduce(u, p, children, ip, frontier, newNode, newEdge);
+            }
+            /* 一般情况：对当前层所有结点做完所有可能的规约 */
+            std::vector<Reduction> R;
+            for (int i = 0; i < frontier.size(); i++) {
+                const std::vector< std::pair<int, int> > &acts = table.actions[gss[frontier[i]].state][j];
+                for (int k = 0; k < acts.size(); k++) {
+                    if (acts[k].first == 2) {
+                        Reduction r = {frontier[i], acts[k].second, -1};
+                        R.push_back(r);
+                    }
+                }
+            }
+            while (!R.empty()) {
+                Reduction r = R.back();
+                R.pop_back();
+                std::vector<int> children;
+                std::vector< std::pair<int, std::vector<int> > > paths;
+                findPaths(r.v, grammar.prods[r.p].rigths.size(), r.edge, children, paths);
+                for (int k = 0; k < paths.size(); k++) {
+                    bool newNode;
+                    int newEdge;
+                    int w = gssReduce(paths[k].first, r.p, paths[k].second, ip, frontier, newNode, newEdge);
+                    if (!newNode && newEdge < 0)
+                        continue;
+                    /* 新结点执行所有规约，已有结点只需沿新加的边重新规约 */
+                    const std::vector< std::pair<int, int> > &acts = table.actions[gss[w].state][j];
+                    for (int t = 0; t < acts.size(); t++) {
+                        if (acts[t].first == 2) {
+                            Reduction nr = {w, acts[t].second, newNode ? -1 : newEdge};
+                            R.push_back(nr);
+                        }
+                    }
+                }
+            }
+            /* 接受 */
+            for (int i = 0; i < frontier.size(); i++) {
+                const std::vector< std::pair<int, int> > &acts = table.actions[gss[frontier[i]].state][j];
+                for (int k = 0; k < acts.size(); k++) {
+                    if (acts[k].first == 3) {
+                        int root = gss[frontier[i]].edges[0].second;
+                        std::map<int, unsigned long long> memo;
+                        std::vector<char> active(sppf.size(), 0);
+                        if (!printDerivation(root, active)) {
+                            printf("cyclic derivation\n");
+                        }
+                        printf("ACC\n");
+                        unsigned long long cnt = countDerivations(root, memo);
+                        if (cnt == CYCLIC) {
+                            printf("forest: %d nodes, cyclic (infinitely many derivations)\n", (int)sppf.size());
+                        } else {
+                            printf("forest: %d nodes, %llu derivations\n", (int)sppf.size(), cnt);
+                        }
+                        return;
+                    }
+                }
+            }
+            /* 移进，状态相同的栈顶合并为一个结点 */
+            SppfNode leaf;
+            leaf.symbol = a;
+            leaf.start = ip;
+            leaf.end = ip + 1;
+            sppf.push_back(leaf);
+            int z = sppf.size() - 1;
+            std::vector<int> next;
+            for (int i = 0; i < frontier.size(); i++) {
+                const std::vector< std::pair<int, int> > &acts = table.actions[gss[frontier[i]].state][j];
+                for (int k = 0; k < acts.size(); k++) {
+                    if (acts[k].first != 1)
+                        continue;
+                    int w = -1;
+                    for (int t = 0; t < next.size(); t++) {
+                        if (gss[next[t]].state == acts[k].second)
+                            w = next[t];
+                    }
+                    if (w < 0) {
+                        w = newGssNode(acts[k].second);
+                        next.push_back(w);
+                    }
+                    gss[w].edges.push_back(std::pair<int, int>(frontier[i], z));
+                }
+            }
+            /* 所有的栈都无法继续 */
+            if (next.empty()) {
+                printf("error\n");
+                return;
+            }
+            frontier = next;
+        }
+        printf("error\n");
+    }
+};
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef LRTABLE_H
+#define LRTABLE_H
+
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+#include "precedence.h"
+
+/* SLR1、LR1两个分析程序共用的分析表：填表时记录冲突，按优先级解决冲突，分析表优化和按使用次数重新编号。
+ * Grammar需要有T、N和prods，产生式需要有char left和vector<char> rigths */
+
+/* 状态数上限：DFA的图和分析表都是按状态数固定大小的数组，加入新状态前检查 */
+const int MAX_STATES = 100;
+/* 终结符数和非终结符数上限 */
+const int MAX_SYMBOLS = 100;
+
+/* ch在V中的序号加1，不在V中时为0，与isInT、isInN相同 */
+inline int symbolIndex(const std::vector<char> &V, char ch)
+{
+    for (int i = 0; i < V.size(); i++) {
+        if (V[i] == ch)
+            return i + 1;
+    }
+    return 0;
+}
+
+/* 新编号到旧编号的顺序：前fixedFront个和后fixedBack个位置不变，其余按使用次数从多到少排列 */
+inline std::vector<int> hotFirst(const std::vector<long long> &hits, int fixedFront, int fixedBack)
+{
+    std::vector<int> order(hits.size());
+    for (int i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin() + fixedFront, order.end() - fixedBack, [&](int a, int b) {
+        return hits[a] > hits[b];
+    });
+    return order;
+}
+
+/* 求顺序的逆，即旧编号到新编号 */
+inline std::vector<int> inverseOf(const std::vector<int> &order)
+{
+    std::vector<int> inv(order.size());
+    for (int i = 0; i < order.size(); i++) {
+        inv[order[i]] = i;
+    }
+    return inv;
+}
+
+/* 把动作中的状态和产生式换成新编号 */
+inline std::pair<int, int> renumberAction(std::pair<int, int> act, const std::vector<int> &ns, const std::vector<int> &np)
+{
+    if (act.first == 1) {
+        act.second = ns[act.second];
+    } else if (act.first == 2 || act.first == 4) {
+        act.second = np[act.second];
+    }
+    return act;
+}
+
+struct LRTable {
+    /* action表和goto表。action的first表示分析动作，0->出错 1->S 2->R 3->ACC，优化后还有4->移进后立即规约，
+     * second表示转移状态或者产生式序号 */
+    std::pair<int, int> action[MAX_STATES][MAX_SYMBOLS];
+    int goton[MAX_STATES][MAX_SYMBOLS];
+    /* actions[i][j]保存状态i遇到第j个终结符时的全部动作，有冲突时不止一个，供GLR分析使用 */
+    std::vector< std::pair<int, int> > actions[MAX_STATES][MAX_SYMBOLS];
+
+    /* 分析表优化的结果：defaultReduce[i]为状态i的默认规约产生式，-1表示没有，此时不必查看向前看符号；
+     * gotoChain[i][j]为状态i经第j个非终结符转移时被跳过的单产生式规约，按规约顺序排列 */
+    int defaultReduce[MAX_STATES];
+    std::vector<int> gotoChain[MAX_STATES][MAX_SYMBOLS];
+
+    /* 优先级声明，以及按优先级解决的冲突数 */
+    Precedence precedence;
+    int resolvedConflicts;
+    /* precedenceError[i][j]表示该表项的冲突按不结合解决为出错，这样的行不能使用默认规约 */
+    bool precedenceError[MAX_STATES][MAX_SYMBOLS];
+
+    /* 填写action表，同时记录到actions中，同一表项出现不同动作即为冲突 */
+    void setAction(int i, int j, int type, int value)
+    {
+        action[i][j].first = type;
+        action[i][j].second = value;
+        std::pair<int, int> act(type, value);
+        if (std::find(actions[i][j].begin(), actions[i][j].end(), act) == actions[i][j].end()) {
+            actions[i][j].push_back(act);
+        }
+    }
+
+    /* 输出前n个状态中的冲突 */
+    template <class Grammar>
+    void printConflicts(const Grammar &grammar, int n) const
+    {
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < grammar.T.size(); j++) {
+                if (actions[i][j].size() <= 1)
+                    continue;
+                printf("conflict at state %d on %c:", i, grammar.T[j]);
+                for (int k = 0; k < actions[i][j].size(); k++) {
+                    std::pair<int, int> act = actions[i][j][k];
+                    if (act.first == 1) {
+                        printf(" S%d", act.second);
+                    } else if (act.first == 2) {
+                        printf(" R%d", act.second);
+                    } else {
+                        printf(" ACC");
+                    }
+                }
+                printf("\n");
+            }
+        }
+    }
+
+    /* 按优先级和结合性解决第i行的移进-规约冲突 */
+    template <class Grammar>
+    void resolveByPrecedence(int i, const Grammar &grammar)
+    {
+        for (int j = 0; j < grammar.T.size(); j++) {
+            std::vector< std::pair<int, int> > &acts = actions[i][j];
+            if (!precedence.resolve(acts, grammar.T[j], grammar.prods))
+                continue;
+            action[i][j] = acts.empty() ? std::pair<int, int>(0, 0) : acts.back();
+            precedenceError[i][j] = acts.empty();
+            resolvedConflicts++;
+        }
+    }
+
+    /* 优化前n个状态的分析表：默认规约、单产生式(A->B)规约的消除、移进-规约合并 */
+    template <class Grammar>
+    void optimizeTable(const Grammar &grammar, int n)
+    {
+        int ndefault = 0, nfused = 0, nbypass = 0;
+        /* 只有一个规约动作且没有其他动作的状态使用默认规约。按不结合出错的表项不是空白，
+         * 默认规约会把出错变成规约，这样的状态不使用默认规约 */
+        for (int i = 0; i < n; i++) {
+            defaultReduce[i] = -1;
+            int p = -1;
+            bool only = true;
+            for (int j = 0; j < grammar.T.size(); j++) {
+                if (precedenceError[i][j]) {
+                    only = false;
+                    break;
+                }
+                if (action[i][j].first == 0)
+                    continue;
+                if (action[i][j].first != 2 || (p >= 0 && action[i][j].second != p)) {
+                    only = false;
+                    break;
+                }
+                p = action[i][j].second;
+            }
+            if (only && p >= 0) {
+                defaultReduce[i] = p;
+                ndefault++;
+            }
+        }
+        /* 移进到默认规约状态时，合并为一个移进-规约动作 */
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < grammar.T.size(); j++) {
+                if (action[i][j].first == 1 && defaultReduce[action[i][j].second] >= 0) {
+                    action[i][j].first = 4;
+                    action[i][j].second = defaultReduce[action[i][j].second];
+                    nfused++;
+                }
+            }
+        }
+        /* 转移到的状态只做单产生式A->B的默认规约时，直接转移到经A到达的状态 */
+        for (int i = 0; i < n; i++) {
+            /* 沿单产生式链查找时使用本行原来的转移，本行前面已经改过的转移会漏掉中间的规约 */
+            int orig[MAX_SYMBOLS];
+            for (int j = 1; j < grammar.N.size(); j++) {
+                orig[j] = goton[i][j];
+            }
+            for (int j = 1; j < grammar.N.size(); j++) {
+                gotoChain[i][j].clear();
+                int t = goton[i][j];
+                /* 限制次数，防止A->B、B->A这样的环 */
+                for (int k = 0; t && k < grammar.prods.size(); k++) {
+                    int p = defaultReduce[t];
+                    if (p < 0)
+                        break;
+                    const std::vector<char> &R = grammar.prods[p].rigths;
+                    if (R.size() != 1 || !symbolIndex(grammar.N, R[0]))
+                        break;
+                    int u = orig[symbolIndex(grammar.N, grammar.prods[p].left) - 1];
+                    if (!u)
+                        break;
+                    gotoChain[i][j].push_back(p);
+                    t = u;
+                }
+                if (!gotoChain[i][j].empty()) {
+                    goton[i][j] = t;
+                    nbypass++;
+                }
+            }
+        }
+        printf("optimize: %d default reductions, %d shift-reduce fusions, %d unit gotos bypassed\n",
+               ndefault, nfused, nbypass);
+    }
+
+    /* 按使用次数重新编号，常用的状态、终结符、非终结符和产生式排在前面，分析表中常用的行和列挤在一起，
+     * isInT/isInN的顺序查找也先找到常用的符号。状态0为初始状态，产生式0为拓广文法的开始产生式，
+     * 非终结符0为开始符号，最后一个终结符为$，这些位置不变。
+     * Collection为项目集规范族，需要有items和DFA的图g，项目集的项目保存在项目池arena中，项目需要有int prod */
+    template <class Grammar, class Collection, class Item>
+    void renumberByProfile(Grammar &grammar, Collection &CC, std::vector<Item> &arena,
+                           const std::vector<long long> &stateHits, const std::vector<long long> &termHits,
+                           const std::vector<long long> &nontermHits, const std::vector<long long> &prodHits)
+    {
+        int n = CC.items.size();
+        int nt = grammar.T.size(), nn = grammar.N.size(), np = grammar.prods.size();
+        std::vector<int> so = hotFirst(stateHits, 1, 0), to = hotFirst(termHits, 0, 1);
+        std::vector<int> no = hotFirst(nontermHits, 1, 0), po = hotFirst(prodHits, 1, 0);
+        std::vector<int> ns = inverseOf(so), pn = inverseOf(po);
+        /* 先复制旧的分析表，再按新编号写回 */
+        std::vector< std::vector< std::pair<int, int> > > oldAction(n, std::vector< std::pair<int, int> >(nt));
+        std::vector< std::vector<bool> > oldError(n, std::vector<bool>(nt));
+        std::vector< std::vector< std::vector< std::pair<int, int> > > > oldActions(
+            n, std::vector< std::vector< std::pair<int, int> > >(nt));
+        std::vector< std::vector<int> > oldGoto(n, std::vector<int>(nn));
+        std::vector< std::vector< std::vector<int> > > oldChain(n, std::vector< std::vector<int> >(nn));
+        std::vector<int> oldDefault(defaultReduce, defaultReduce + n);
+        std::vector< std::vector< std::pair<int, char> > > oldG(CC.g, CC.g + n);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < nt; j++) {
+                oldAction[i][j] = action[i][j];
+                oldActions[i][j] = actions[i][j];
+                oldError[i][j] = precedenceError[i][j];
+            }
+            for (int j = 0; j < nn; j++) {
+                oldGoto[i][j] = goton[i][j];
+                oldChain[i][j] = gotoChain[i][j];
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            int s = so[i];
+            for (int j = 0; j < nt; j++) {
+                action[i][j] = renumberAction(oldAction[s][to[j]], ns, pn);
+                precedenceError[i][j] = oldError[s][to[j]];
+                actions[i][j].clear();
+                for (int k = 0; k < oldActions[s][to[j]].size(); k++) {
+                    actions[i][j].push_back(renumberAction(oldActions[s][to[j]][k], ns, pn));
+                }
+            }
+            for (int j = 0; j < nn; j++) {
+                goton[i][j] = ns[oldGoto[s][no[j]]];
+                gotoChain[i][j] = oldChain[s][no[j]];
+                for (int k = 0; k < gotoChain[i][j].size(); k++) {
+                    gotoChain[i][j][k] = pn[gotoChain[i][j][k]];
+                }
+            }
+            defaultReduce[i] = oldDefault[s] >= 0 ? pn[oldDefault[s]] : -1;
+            CC.g[i].clear();
+            for (int k = 0; k < oldG[s].size(); k++) {
+                std::pair<char, int> p = oldG[s][k];
+                CC.g[i].push_back(std::pair<char, int>(p.first, ns[p.second]));
+            }
+        }
+        auto items = CC.items;
+        for (int i = 0; i < n; i++) {
+            items[i] = CC.items[so[i]];
+        }
+        CC.items = items;
+        Grammar oldGrammar = grammar;
+        for (int j = 0; j < nt; j++) {
+            grammar.T[j] = oldGrammar.T[to[j]];
+        }
+        for (int j = 0; j < nn; j++) {
+            grammar.N[j] = oldGrammar.N[no[j]];
+        }
+        for (int k = 0; k < np; k++) {
+            grammar.prods[k] = oldGrammar.prods[po[k]];
+        }
+        /* 项目中的产生式序号也换成新编号，项目集才仍然描述原来的项目 */
+        for (int k = 0; k < arena.size(); k++) {
+            arena[k].prod = pn[arena[k].prod];
+        }
+        printf("profile: state order");
+        for (int i = 0; i < n; i++) {
+            printf(" %d", so[i]);
+        }
+        printf("\nprofile: terminal order %s, non-terminal order %s, production order",
+               std::string(grammar.T.begin(), grammar.T.end()).c_str(),
+               std::string(grammar.N.begin(), grammar.N.end()).c_str());
+        for (int k = 0; k < np; k++) {
+            printf(" %d", po[k]);
+        }
+        printf("\n");
+    }
+};
+
+#endif
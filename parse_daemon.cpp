@@ -0,0 +1,438 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <unistd.h>
+#include <signal.h>
+#include <spawn.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+#include "parser.h"
+#include "simplify.h"
+using namespace std;
+
+/* 常驻的语法分析服务：启动时读入文法并构建一次分析表，之后通过Unix域套接字处理分析请求。
+ * 协议：每条消息为4字节网络字节序的长度加上内容。
+ * 请求内容为"文法名\n待分析串"，应答内容为"ACC\n"加上每行一个产生式，或者"error\n" */
+
+extern char **environ;
+
+/* 文法名到分析表句柄的映射，启动后不再增删，各个线程共享；收到SIGHUP时重新读入文法并热替换分析表 */
+map<string, TableHandle *> tables;
+/* 文法名到"ENGINE:文件名"的映射，重新读入时使用 */
+map<string, string> specs;
+/* 文法名到结果缓存的映射，serve指定--cache时才有，所有连接共享 */
+map<string, ResultCache *> caches;
+
+/* 读满len个字节 */
+bool readAll(int fd, char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = read(fd, buf, len);
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+/* 写满len个字节 */
+bool writeAll(int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+/* 读入一条消息 */
+bool readMessage(int fd, string &msg)
+{
+    uint32_t len;
+    if (!readAll(fd, (char *)&len, 4))
+        return false;
+    msg.resize(ntohl(len));
+    return msg.empty() || readAll(fd, &msg[0], msg.size());
+}
+
+/* 发送一条消息 */
+bool writeMessage(int fd, const string &msg)
+{
+    uint32_t len = htonl(msg.size());
+    return writeAll(fd, (const char *)&len, 4) && writeAll(fd, msg.data(), msg.size());
+}
+
+/* simplify.h中reduceGrammar所需的文法形式 */
+struct ReducibleGrammar {
+    int num;
+    vector<char> T;
+    vector<char> N;
+    vector<Production> prods;
+};
+
+/* 与分析程序一样删去无用和不可达的符号及产生式。reduceGrammar的说明写在标准输出，
+ * 而oneshot和batch的标准输出是应答，这里临时改写到标准错误输出 */
+void reduce(Grammar &g)
+{
+    ReducibleGrammar r;
+    r.num = g.prods.size();
+    r.T = g.T;
+    r.N = g.N;
+    r.prods = g.prods;
+    fflush(stdout);
+    int saved = dup(1);
+    dup2(2, 1);
+    reduceGrammar(r);
+    fflush(stdout);
+    dup2(saved, 1);
+    close(saved);
+    g.T = r.T;
+    g.N = r.N;
+    g.prods = r.prods;
+}
+
+/* 解析"LL1/SLR1/LR1/AUTO:文件名"并读入、化简文法，AUTO时选出没有冲突的代价最低的方法 */
+bool loadGrammar(const string &spec, Grammar &g, Engine &e)
+{
+    size_t colon = spec.find(':');
+    if (colon == string::npos)
+        return false;
+    string engine = spec.substr(0, colon);
+    if (engine == "LL1") {
+        e = ENGINE_LL1;
+    } else if (engine == "SLR1") {
+        e = ENGINE_SLR1;
+    } else if (engine == "LR1") {
+        e = ENGINE_LR1;
+    } else if (engine != "AUTO") {
+        return false;
+    }
+    ifstream in(spec.substr(colon + 1).c_str());
+    if (!readGrammar(in, g))
+        return false;
+    reduce(g);
+    if (engine == "AUTO") {
+        string reason;
+        e = buildCheapestParseTable(g, &reason)->engine;
+        fprintf(stderr, "%s:\n%s\n", spec.c_str(), reason.c_str());
+    }
+    return true;
+}
+
+/* 在标准错误输出分析表中的冲突 */
+void printConflicts(const string &name, const ParseTable &t)
+{
+    for (int k = 0; k < t.conflicts.size(); k++) {
+        fprintf(stderr, "%s: conflict %s\n", name.c_str(), t.conflicts[k].c_str());
+    }
+}
+
+/* 读入文法并构建分析表。分析程序在冲突处保留后填入的动作(GLR模式保留全部)，库保留先填入的，
+ * 同一个文法会得到不同的推导，所以有冲突的文法不载入 */
+shared_ptr<const ParseTable> loadTable(const string &spec)
+{
+    Grammar g;
+    Engine e;
+    shared_ptr<const ParseTable> t;
+    /* AUTO时直接使用选择过程中构建好的分析表 */
+    if (spec.compare(0, 5, "AUTO:") == 0) {
+        ifstream in(spec.substr(5).c_str());
+        string reason;
+        if (!readGrammar(in, g))
+            return shared_ptr<const ParseTable>();
+        reduce(g);
+        t = buildCheapestParseTable(g, &reason);
+        fprintf(stderr, "%s:\n%s\n", spec.c_str(), reason.c_str());
+    } else {
+        if (!loadGrammar(spec, g, e))
+            return shared_ptr<const ParseTable>();
+        t = buildParseTable(g, e);
+    }
+    if (!t->conflicts.empty()) {
+        printConflicts(spec, *t);
+        return shared_ptr<const ParseTable>();
+    }
+    return t;
+}
+
+/* 输出缓存的命中率 */
+void printCacheStats(FILE *out, const string &name, const ResultCache &c)
+{
+    unsigned long long total = c.hits() + c.misses();
+    fprintf(out, "%s cache: %llu hits, %llu misses, %.1f%% hit rate, %d entries\n", name.c_str(), c.hits(),
+            c.misses(), total == 0 ? 0.0 : 100.0 * c.hits() / total, (int)c.size());
+}
+
+/* 等待SIGHUP，在后台重新读入所有文法并替换分析表，分析线程不受影响 */
+void reloadLoop(sigset_t set)
+{
+    while (1) {
+        int sig;
+        if (sigwait(&set, &sig) != 0)
+            continue;
+        for (auto it = specs.begin(); it != specs.end(); it++) {
+            Grammar g;
+            Engine e;
+            if (!loadGrammar(it->second, g, e)) {
+                fprintf(stderr, "cannot reload grammar %s\n", it->first.c_str());
+                continue;
+            }
+            /* 与载入时一样拒绝有冲突的文法，继续使用旧版本 */
+            shared_ptr<const ParseTable> t = buildParseTable(g, e);
+            if (!t->conflicts.empty()) {
+                printConflicts(it->second, *t);
+                fprintf(stderr, "cannot reload grammar %s\n", it->first.c_str());
+                continue;
+            }
+            unsigned version = tables[it->first]->rebuild(g, e).get();
+            printf("reloaded %s as version %u\n", it->first.c_str(), version);
+            auto cit = caches.find(it->first);
+            if (cit != caches.end()) {
+                printCacheStats(stdout, it->first, *cit->second);
+            }
+            fflush(stdout);
+        }
+    }
+}
+
+/* 分析一个请求，得到应答内容 */
+string answer(Parser &p, const string &input)
+{
+    vector<int> derivation;
+    if (!p.parse(input, derivation))
+        return "error\n";
+    string out = "ACC\n";
+    for (int i = 0; i < derivation.size(); i++) {
+        out += productionText(p.table->prods[derivation[i]]);
+        out += '\n';
+    }
+    return out;
+}
+
+/* 处理一个客户端的所有请求 */
+void serveClient(int fd)
+{
+    /* 每个连接为每个文法保留一个分析器，重复使用其分析栈 */
+    map<string, Parser> parsers;
+    string req;
+    while (readMessage(fd, req)) {
+        size_t nl = req.find('\n');
+        string name = req.substr(0, nl);
+        string input = nl == string::npos ? "" : req.substr(nl + 1);
+        auto it = tables.find(name);
+        string resp;
+        if (it == tables.end()) {
+            resp = "unknown grammar\n";
+        } else {
+            auto pit = parsers.find(name);
+            if (pit == parsers.end()) {
+                pit = parsers.insert(make_pair(name, Parser(*it->second))).first;
+                auto cit = caches.find(name);
+                if (cit != caches.end())
+                    pit->second.results = cit->second;
+            }
+            resp = answer(pit->second, input);
+        }
+        if (!writeMessage(fd, resp))
+            break;
+    }
+    close(fd);
+}
+
+/* 打开Unix域套接字 */
+int openSocket(const string &path, bool listening)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (listening) {
+        unlink(path.c_str());
+        if (bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+            close(fd);
+            return -1;
+        }
+    } else if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* serve SOCKET [--cache N] NAME=ENGINE:FILE ... */
+int serve(int argc, char *argv[])
+{
+    int first = 3, cacheSize = 0;
+    if (argc > 4 && strcmp(argv[3], "--cache") == 0) {
+        cacheSize = atoi(argv[4]);
+        first = 5;
+    }
+    for (int i = first; i < argc; i++) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        shared_ptr<const ParseTable> t;
+        if (eq != string::npos)
+            t = loadTable(arg.substr(eq + 1));
+        if (!t) {
+            fprintf(stderr, "cannot load grammar %s\n", argv[i]);
+            return 1;
+        }
+        tables[arg.substr(0, eq)] = new TableHandle(t);
+        specs[arg.substr(0, eq)] = arg.substr(eq + 1);
+        if (cacheSize > 0)
+            caches[arg.substr(0, eq)] = new ResultCache(cacheSize);
+    }
+    /* 所有线程都屏蔽SIGHUP，只由reloadLoop等待 */
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    thread(reloadLoop, set).detach();
+    int lfd = openSocket(argv[2], true);
+    if (lfd < 0) {
+        perror("socket");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    printf("serving %d grammars on %s\n", (int)tables.size(), argv[2]);
+    fflush(stdout);
+    /* 每个客户端一个线程，并发处理 */
+    while (1) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0)
+            continue;
+        thread(serveClient, fd).detach();
+    }
+}
+
+/* oneshot ENGINE:FILE INPUT，相当于每次启动一个进程构建分析表并分析 */
+int oneshot(char *argv[])
+{
+    shared_ptr<const ParseTable> t = loadTable(argv[2]);
+    if (!t) {
+        fprintf(stderr, "cannot load grammar %s\n", argv[2]);
+        return 1;
+    }
+    Parser p(t);
+    fputs(answer(p, argv[3]).c_str(), stdout);
+    return 0;
+}
+
+/* batch ENGINE:FILE INPUTS [CACHE]：逐行分析INPUTS中的串，应答输出到标准输出，
+ * CACHE大于0时使用结果缓存，最后在标准错误输出耗时和命中率 */
+int batch(int argc, char *argv[])
+{
+    shared_ptr<const ParseTable> t = loadTable(argv[2]);
+    if (!t) {
+        fprintf(stderr, "cannot load grammar %s\n", argv[2]);
+        return 1;
+    }
+    ifstream in(argv[3]);
+    if (!in) {
+        fprintf(stderr, "cannot open %s\n", argv[3]);
+        return 1;
+    }
+    vector<string> inputs;
+    string line;
+    while (getline(in, line)) {
+        inputs.push_back(line);
+    }
+    int cacheSize = argc > 4 ? atoi(argv[4]) : 0;
+    ResultCache cache(cacheSize);
+    Parser p(t);
+    if (cacheSize > 0)
+        p.results = &cache;
+    auto begin = chrono::steady_clock::now();
+    for (int i = 0; i < inputs.size(); i++) {
+        fputs(answer(p, inputs[i]).c_str(), stdout);
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+    fprintf(stderr, "%d inputs in %.1f ms\n", (int)inputs.size(), ms);
+    if (cacheSize > 0)
+        printCacheStats(stderr, argv[2], cache);
+    return 0;
+}
+
+/* bench SOCKET NAME INPUT COUNT [ENGINE:FILE]，比较常驻服务和每次启动进程的延迟 */
+int bench(int argc, char *argv[])
+{
+    int count = atoi(argv[5]);
+    int fd = openSocket(argv[2], false);
+    if (fd < 0) {
+        perror("connect");
+        return 1;
+    }
+    string req = string(argv[3]) + "\n" + argv[4];
+    string resp;
+    auto begin = chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        if (!writeMessage(fd, req) || !readMessage(fd, resp)) {
+            fprintf(stderr, "daemon closed the connection\n");
+            return 1;
+        }
+    }
+    double daemonUs = chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count() / count;
+    close(fd);
+    printf("daemon:  %.1f us per request\n", daemonUs);
+    if (argc <= 6)
+        return 0;
+    /* 每次启动本程序的oneshot模式，输出丢弃 */
+    char self[4096];
+    ssize_t n = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (n <= 0)
+        return 1;
+    self[n] = 0;
+    char mode[] = "oneshot";
+    char *args[] = {self, mode, argv[6], argv[4], NULL};
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addopen(&fa, 1, "/dev/null", O_WRONLY, 0);
+    begin = chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        pid_t pid;
+        if (posix_spawn(&pid, self, &fa, NULL, args, environ) != 0)
+            return 1;
+        waitpid(pid, NULL, 0);
+    }
+    double oneshotUs = chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count() / count;
+    posix_spawn_file_actions_destroy(&fa);
+    printf("oneshot: %.1f us per request (%.1fx)\n", oneshotUs, oneshotUs / daemonUs);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    string mode = argc > 1 ? argv[1] : "";
+    if (mode == "serve" && argc >= 4)
+        return serve(argc, argv);
+    if (mode == "oneshot" && argc == 4)
+        return oneshot(argv);
+    if (mode == "bench" && argc >= 6)
+        return bench(argc, argv);
+    if (mode == "batch" && argc >= 4)
+        return batch(argc, argv);
+    fprintf(stderr, "usage:\n"
+            "  %s serve SOCKET [--cache N] NAME=ENGINE:FILE ...\n"
+            "  %s oneshot ENGINE:FILE INPUT\n"
+            "  %s bench SOCKET NAME INPUT COUNT [ENGINE:FILE]\n"
+            "  %s batch ENGINE:FILE INPUTS [CACHE]\n"
+            "ENGINE is LL1, SLR1, LR1 or AUTO (the cheapest conflict-free one)\n"
+            "--cache/CACHE keep up to N results of repeated inputs\n", argv[0], argv[0], argv[0], argv[0]);
+    return 1;
+}
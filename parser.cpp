@@ -0,0 +1,1259 @@
+#include "parser.h"
+#include <cstdio>
+#include <sstream>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <ctime>
+using namespace std;
+
+Grammar &Grammar::production(const string &s)
+{
+    Production P;
+    P.left = s[0];
+    for (int j = 3; j < s.size(); j++) {
+        P.rigths.push_back(s[j]);
+    }
+    prods.push_back(P);
+    return *this;
+}
+
+Grammar &Grammar::nonterminals(const string &s)
+{
+    for (int i = 0; i < s.size(); i++) {
+        if (s[i] != ' ')
+            N.push_back(s[i]);
+    }
+    return *this;
+}
+
+Grammar &Grammar::terminals(const string &s)
+{
+    for (int i = 0; i < s.size(); i++) {
+        if (s[i] != ' ')
+            T.push_back(s[i]);
+    }
+    return *this;
+}
+
+Grammar &Grammar::precedence(const string &s)
+{
+    istringstream in(s + " #");
+    prec.read(in);
+    return *this;
+}
+
+bool readGrammar(istream &in, Grammar &g)
+{
+    int num;
+    if (!(in >> num))
+        return false;
+    string s;
+    for (int i = 0; i < num; i++) {
+        if (!(in >> s))
+            return false;
+        g.production(s);
+    }
+    char ch;
+    if (!(in >> ch))
+        return false;
+    while (ch != '#') {
+        g.N.push_back(ch);
+        if (!(in >> ch))
+            return false;
+    }
+    if (!(in >> ch))
+        return false;
+    while (ch != '#') {
+        g.T.push_back(ch);
+        if (!(in >> ch))
+            return false;
+    }
+    g.prec.read(in);
+    return true;
+}
+
+string productionText(const Production &P)
+{
+    string s;
+    s += P.left;
+    s += "->";
+    s.append(P.rigths.begin(), P.rigths.end());
+    return s;
+}
+
+/* LR项目，SLR1中向前看符号next为0 */
+struct Item {
+    int prod;
+    int location;
+    char next;
+    bool operator<(const Item &rhs) const
+    {
+        if (prod != rhs.prod)
+            return prod < rhs.prod;
+        if (location != rhs.location)
+            return location < rhs.location;
+        return next < rhs.next;
+    }
+    bool operator==(const Item &rhs) const
+    {
+        return prod == rhs.prod && location == rhs.location && next == rhs.next;
+    }
+};
+
+/* 构建分析表的中间结果，随分析表保存，增量更新时使用 */
+struct BuildCache {
+    /* FIRST集(不含空)、能否推空和FOLLOW集，以字符为下标 */
+    set<char> first[256];
+    bool nullable[256];
+    set<char> follow[256];
+    /* LR项目集规范族，项目集及其核心都按序排好 */
+    vector< vector<Item> > states;
+    vector< vector<Item> > kernels;
+};
+
+/* 构建分析表时使用的临时数据，每次构建一个，互不影响 */
+struct TableBuilder {
+    ParseTable &t;
+    shared_ptr<BuildCache> c;
+    set<char> *first;
+    bool *nullable;
+    set<char> *follow;
+    vector< vector<Item> > &states;
+    vector< vector<Item> > &kernels;
+    /* 由核心查找状态，同一个核心只求一次闭包 */
+    map<vector<Item>, int> stateIndex;
+    vector< vector< pair<char, int> > > edges;
+
+    /* 增量构建时的旧中间结果和旧产生式序号到新序号的映射，-1表示被删除 */
+    const BuildCache *old;
+    vector<int> oldToNew;
+    /* 产生式有增删或者FIRST集、能否推空发生变化的非终结符 */
+    bool dirty[256];
+    /* 可以沿用闭包的旧状态，以换成新序号的核心为键 */
+    map<vector<Item>, int> reusable;
+
+    explicit TableBuilder(ParseTable &table)
+        : t(table), c(new BuildCache()), first(c->first), nullable(c->nullable), follow(c->follow),
+          states(c->states), kernels(c->kernels), old(NULL)
+    {
+    }
+
+    /* 产生式p右部第k个符号，超出右部时返回0 */
+    char symbolAt(int p, int k)
+    {
+        return k < t.rhsLen[p] ? t.prods[p].rigths[k] : 0;
+    }
+
+    /* 求第p个产生式右部从第k个符号开始的后缀的FIRST集，返回后缀能否推空 */
+    bool firstOfSuffix(int p, int k, set<char> &FS)
+    {
+        for (; k < t.rhsLen[p]; k++) {
+            char X = t.prods[p].rigths[k];
+            FS.insert(first[(unsigned char)X].begin(), first[(unsigned char)X].end());
+            if (!nullable[(unsigned char)X])
+                return false;
+        }
+        return true;
+    }
+
+    /* 求FIRST集和FOLLOW集 */
+    void getFirstFollow()
+    {
+        for (int i = 0; i < 256; i++) {
+            nullable[i] = false;
+        }
+        for (int i = 0; i < t.T.size(); i++) {
+            first[(unsigned char)t.T[i]].insert(t.T[i]);
+        }
+        /* 当FIRST集或能否推空发生变化时循环 */
+        bool change = true;
+        while (change) {
+            change = false;
+            for (int p = 0; p < t.prods.size(); p++) {
+                unsigned char A = t.prods[p].left;
+                int before = first[A].size();
+                bool n = firstOfSuffix(p, 0, first[A]);
+                if (first[A].size() != before)
+                    change = true;
+                if (n && !nullable[A]) {
+                    nullable[A] = true;
+                    change = true;
+                }
+            }
+        }
+        follow[(unsigned char)t.N[0]].insert('$');
+        change = true;
+        while (change) {
+            change = false;
+            for (int p = 0; p < t.prods.size(); p++) {
+                unsigned char A = t.prods[p].left;
+                for (int k = 0; k < t.rhsLen[p]; k++) {
+                    unsigned char B = t.prods[p].rigths[k];
+                    if (t.nontermIndex[B] < 0)
+                        continue;
+                    int before = follow[B].size();
+                    if (firstOfSuffix(p, k + 1, follow[B])) {
+                        follow[B].insert(follow[A].begin(), follow[A].end());
+                    }
+                    if (follow[B].size() != before)
+                        change = true;
+                }
+            }
+        }
+    }
+
+    /* 增量求FIRST集和FOLLOW集，oldProds为旧文法的产生式。
+     * 产生式有增删的非终结符及其在依赖关系上的祖先重新求FIRST集，其余沿用旧值；
+     * FOLLOW集只重新求来源发生变化的非终结符 */
+    void updateFirstFollow(const vector<Production> &oldProds)
+    {
+        vector<bool> added(t.prods.size(), true);
+        bool changed[256] = {false};
+        bool affected[256];
+        for (int p = 0; p < oldProds.size(); p++) {
+            if (oldToNew[p] >= 0) {
+                added[oldToNew[p]] = false;
+            } else {
+                changed[(unsigned char)oldProds[p].left] = true;
+            }
+        }
+        for (int p = 0; p < t.prods.size(); p++) {
+            if (added[p])
+                changed[(unsigned char)t.prods[p].left] = true;
+        }
+        /* 右部含有受影响的非终结符的产生式，其左部的FIRST集也受影响 */
+        for (int i = 0; i < 256; i++) {
+            affected[i] = changed[i];
+        }
+        bool change = true;
+        while (change) {
+            change = false;
+            for (int p = 0; p < t.prods.size(); p++) {
+                unsigned char A = t.prods[p].left;
+                for (int k = 0; k < t.rhsLen[p] && !affected[A]; k++) {
+                    if (affected[(unsigned char)t.prods[p].rigths[k]]) {
+                        affected[A] = true;
+                        change = true;
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < 256; i++) {
+            if (!affected[i]) {
+                first[i] = old->first[i];
+                nullable[i] = old->nullable[i];
+            } else {
+                nullable[i] = false;
+            }
+        }
+        change = true;
+        while (change) {
+            change = false;
+            for (int p = 0; p < t.prods.size(); p++) {
+                unsigned char A = t.prods[p].left;
+                if (!affected[A])
+                    continue;
+                int before = first[A].size();
+                bool n = firstOfSuffix(p, 0, first[A]);
+                if (first[A].size() != before)
+                    change = true;
+                if (n && !nullable[A]) {
+                    nullable[A] = true;
+                    change = true;
+                }
+            }
+        }
+        for (int i = 0; i < 256; i++) {
+            dirty[i] = changed[i] || (affected[i] && (first[i] != old->first[i] || nullable[i] != old->nullable[i]));
+        }
+        /* FOLLOW集受影响的非终结符：出现在增删的产生式右部，后面的符号串含有dirty的符号，
+         * 或者后面的符号串能推空且左部的FOLLOW集受影响 */
+        bool refollow[256] = {false};
+        for (int p = 0; p < oldProds.size(); p++) {
+            if (oldToNew[p] >= 0)
+                continue;
+            for (int k = 0; k < oldProds[p].rigths.size(); k++) {
+                refollow[(unsigned char)oldProds[p].rigths[k]] = true;
+            }
+        }
+        change = true;
+        while (change) {
+            change = false;
+            for (int p = 0; p < t.prods.size(); p++) {
+                unsigned char A = t.prods[p].left;
+                for (int k = 0; k < t.rhsLen[p]; k++) {
+                    unsigned char B = t.prods[p].rigths[k];
+                    if (t.nontermIndex[B] < 0 || refollow[B])
+                        continue;
+                    bool affect = added[p];
+                    bool n = true;
+                    for (int m = k + 1; m < t.rhsLen[p] && !affect; m++) {
+                        unsigned char X = t.prods[p].rigths[m];
+                        affect = dirty[X];
+                        n = n && nullable[X];
+                    }
+                    if (affect || (n && refollow[A])) {
+                        refollow[B] = true;
+                        change = true;
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < 256; i++) {
+            if (!refollow[i])
+                follow[i] = old->follow[i];
+        }
+        if (refollow[(unsigned char)t.N[0]])
+            follow[(unsigned char)t.N[0]].insert('$');
+        change = true;
+        while (change) {
+            change = false;
+            for (int p = 0; p < t.prods.size(); p++) {
+                unsigned char A = t.prods[p].left;
+                for (int k = 0; k < t.rhsLen[p]; k++) {
+                    unsigned char B = t.prods[p].rigths[k];
+                    if (t.nontermIndex[B] < 0 || !refollow[B])
+                        continue;
+                    int before = follow[B].size();
+                    if (firstOfSuffix(p, k + 1, follow[B])) {
+                        follow[B].insert(follow[A].begin(), follow[A].end());
+                    }
+                    if (follow[B].size() != before)
+                        change = true;
+                }
+            }
+        }
+    }
+
+    /* 找出闭包不受文法修改影响的旧状态：闭包中没有被删除的产生式，
+     * 项目点后面的符号都不是dirty的非终结符(不会展开出不同的产生式，向前看符号也不变) */
+    void findReusableStates(const vector<Production> &oldProds)
+    {
+        for (int s = 0; s < old->states.size(); s++) {
+            const vector<Item> &I = old->states[s];
+            bool ok = true;
+            for (int k = 0; k < I.size() && ok; k++) {
+                if (oldToNew[I[k].prod] < 0) {
+                    ok = false;
+                    break;
+                }
+                const vector<char> &R = oldProds[I[k].prod].rigths;
+                for (int m = I[k].location; m < R.size() && ok; m++) {
+                    ok = !dirty[(unsigned char)R[m]];
+                }
+            }
+            if (!ok)
+                continue;
+            vector<Item> K = old->kernels[s];
+            for (int k = 0; k < K.size(); k++) {
+                K[k].prod = oldToNew[K[k].prod];
+            }
+            sort(K.begin(), K.end());
+            reusable[K] = s;
+        }
+    }
+
+    /* 构建LL1预测分析表 */
+    void buildLL1()
+    {
+        t.M.assign(t.N.size() * t.T.size(), -1);
+        for (int p = 0; p < t.prods.size(); p++) {
+            Production &P = t.prods[p];
+            set<char> FS;
+            /* 如果右部能推空，则FOLLOW(A)中的符号也选择该产生式 */
+            if (firstOfSuffix(p, 0, FS)) {
+                FS.insert(follow[(unsigned char)P.left].begin(), follow[(unsigned char)P.left].end());
+            }
+            int i = t.nontermIndex[(unsigned char)P.left];
+            for (auto it = FS.begin(); it != FS.end(); it++) {
+                int j = t.termIndex[(unsigned char)*it];
+                int &cell = t.M[i * t.T.size() + j];
+                if (cell >= 0 && cell != p) {
+                    t.conflicts.push_back(string("M[") + P.left + ", " + *it + "]: " +
+                                          productionText(t.prods[cell]) + " / " + productionText(P));
+                    continue;
+                }
+                cell = p;
+            }
+        }
+        /* 逆序且去掉空的右部 */
+        for (int p = 0; p < t.prods.size(); p++) {
+            int begin = t.rhsPool.size();
+            for (int k = t.rhsLen[p] - 1; k >= 0; k--) {
+                t.rhsPool.push_back(t.prods[p].rigths[k]);
+            }
+            t.rhsSpan.push_back(pair<int, int>(begin, t.rhsPool.size() - begin));
+        }
+    }
+
+    /* 求项目集I的闭包，结果按序排好 */
+    void closure(vector<Item> &I, bool lr1)
+    {
+        set<Item> S(I.begin(), I.end());
+        vector<Item> work(I.begin(), I.end());
+        while (!work.empty()) {
+            Item L = work.back();
+            work.pop_back();
+            char B = symbolAt(L.prod, L.location);
+            if (!B || t.nontermIndex[(unsigned char)B] < 0)
+                continue;
+            /* 新项目的向前看符号为FIRST(βa) */
+            set<char> FS;
+            if (lr1) {
+                if (firstOfSuffix(L.prod, L.location + 1, FS))
+                    FS.insert(L.next);
+            } else {
+                FS.insert(0);
+            }
+            for (int p = 0; p < t.prods.size(); p++) {
+                if (t.prods[p].left != B)
+                    continue;
+                for (auto it = FS.begin(); it != FS.end(); it++) {
+                    Item n = {p, 0, *it};
+                    if (S.insert(n).second)
+                        work.push_back(n);
+                }
+            }
+        }
+        I.assign(S.begin(), S.end());
+    }
+
+    /* 由核心K查找项目集，不存在时求闭包并加入规范族，返回序号 */
+    int addState(vector<Item> &K, bool lr1)
+    {
+        auto it = stateIndex.find(K);
+        if (it != stateIndex.end())
+            return it->second;
+        vector<Item> I;
+        auto r = reusable.find(K);
+        if (r != reusable.end()) {
+            /* 沿用旧状态的闭包，换成新的产生式序号 */
+            I = old->states[r->second];
+            for (int k = 0; k < I.size(); k++) {
+                I[k].prod = oldToNew[I[k].prod];
+            }
+            sort(I.begin(), I.end());
+        } else {
+            I = K;
+            closure(I, lr1);
+        }
+        states.push_back(I);
+        kernels.push_back(K);
+        edges.push_back(vector< pair<char, int> >());
+        stateIndex[K] = states.size() - 1;
+        return states.size() - 1;
+    }
+
+    /* 把分析动作写成S3、R2、ACC的形式 */
+    static string actionText(int type, int value)
+    {
+        char buf[16];
+        if (type == 3)
+            return "ACC";
+        snprintf(buf, sizeof(buf), "%c%d", type == 1 ? 'S' : 'R', value);
+        return buf;
+    }
+
+    /* 记录表项的一个动作，重复的动作只记一次 */
+    static void addAction(vector< pair<int, int> > &acts, int type, int value)
+    {
+        pair<int, int> act(type, value);
+        if (find(acts.begin(), acts.end(), act) == acts.end())
+            acts.push_back(act);
+    }
+
+    /* 填写action表，冲突时保留先填入的动作 */
+    void setAction(int s, int j, int type, int value)
+    {
+        pair<int, int> &cell = t.action[s * t.T.size() + j];
+        if (cell.first != 0 && cell != pair<int, int>(type, value)) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "state %d on %c: ", s, t.T[j]);
+            t.conflicts.push_back(buf + actionText(cell.first, cell.second) + " / " + actionText(type, value));
+            return;
+        }
+        cell = pair<int, int>(type, value);
+    }
+
+    /* 构建SLR1或LR1的项目集规范族和分析表 */
+    void buildLR(bool lr1)
+    {
+        vector<Item> K;
+        Item start = {0, 0, lr1 ? '$' : (char)0};
+        K.push_back(start);
+        addState(K, lr1);
+        for (int s = 0; s < states.size(); s++) {
+            /* 按点后面的符号分桶，一次求出所有转移 */
+            map<char, vector<Item> > buckets;
+            for (int k = 0; k < states[s].size(); k++) {
+                Item L = states[s][k];
+                char X = symbolAt(L.prod, L.location);
+                if (X) {
+                    L.location++;
+                    buckets[X].push_back(L);
+                }
+            }
+            for (auto it = buckets.begin(); it != buckets.end(); it++) {
+                int to = addState(it->second, lr1);
+                edges[s].push_back(pair<char, int>(it->first, to));
+            }
+        }
+        t.states = states.size();
+        t.action.assign(t.states * t.T.size(), pair<int, int>(0, 0));
+        t.go.assign(t.states * t.N.size(), -1);
+        int end = t.T.size() - 1;
+        for (int s = 0; s < t.states; s++) {
+            /* 先收集一行中每个表项的全部动作，按优先级解决冲突后再填表 */
+            vector< vector< pair<int, int> > > acts(t.T.size());
+            for (int k = 0; k < edges[s].size(); k++) {
+                unsigned char X = edges[s][k].first;
+                if (t.termIndex[X] >= 0) {
+                    addAction(acts[t.termIndex[X]], 1, edges[s][k].second);
+                } else if (t.nontermIndex[X] >= 0) {
+                    t.go[s * t.N.size() + t.nontermIndex[X]] = edges[s][k].second;
+                }
+            }
+            for (int k = 0; k < states[s].size(); k++) {
+                Item &L = states[s][k];
+                if (symbolAt(L.prod, L.location))
+                    continue;
+                /* 接受项目 */
+                if (L.prod == 0) {
+                    addAction(acts[end], 3, 0);
+                } else if (lr1) {
+                    addAction(acts[t.termIndex[(unsigned char)L.next]], 2, L.prod);
+                } else {
+                    set<char> &F = follow[(unsigned char)t.prods[L.prod].left];
+                    for (auto it = F.begin(); it != F.end(); it++) {
+                        addAction(acts[t.termIndex[(unsigned char)*it]], 2, L.prod);
+                    }
+                }
+            }
+            for (int j = 0; j < t.T.size(); j++) {
+                t.prec.resolve(acts[j], t.T[j], t.prods);
+                for (int k = 0; k < acts[j].size(); k++) {
+                    setAction(s, j, acts[j][k].first, acts[j][k].second);
+                }
+            }
+        }
+    }
+};
+
+/* 填写分析表中与构建方法无关的部分 */
+static shared_ptr<ParseTable> newTable(const Grammar &g, Engine engine, unsigned version)
+{
+    shared_ptr<ParseTable> t(new ParseTable());
+    t->engine = engine;
+    t->version = version;
+    t->prods = g.prods;
+    t->N = g.N;
+    t->T = g.T;
+    t->prec = g.prec;
+    /* 把$当作终结符 */
+    t->T.push_back('$');
+    for (int i = 0; i < 256; i++) {
+        t->termIndex[i] = -1;
+        t->nontermIndex[i] = -1;
+    }
+    for (int i = 0; i < t->T.size(); i++) {
+        t->termIndex[(unsigned char)t->T[i]] = i;
+    }
+    for (int i = 0; i < t->N.size(); i++) {
+        t->nontermIndex[(unsigned char)t->N[i]] = i;
+    }
+    for (int p = 0; p < t->prods.size(); p++) {
+        vector<char> &R = t->prods[p].rigths;
+        t->rhsLen.push_back(R.size() == 1 && R[0] == '&' ? 0 : R.size());
+    }
+    t->states = 0;
+    return t;
+}
+
+shared_ptr<const ParseTable> buildParseTable(const Grammar &g, Engine engine, unsigned version)
+{
+    shared_ptr<ParseTable> t = newTable(g, engine, version);
+    TableBuilder b(*t);
+    b.getFirstFollow();
+    if (engine == ENGINE_LL1) {
+        b.buildLL1();
+    } else {
+        b.buildLR(engine == ENGINE_LR1);
+    }
+    t->cache = b.c;
+    return t;
+}
+
+shared_ptr<const ParseTable> buildCheapestParseTable(const Grammar &g, string *reason)
+{
+    static const Engine order[] = {ENGINE_LL1, ENGINE_SLR1, ENGINE_LR1};
+    static const char *names[] = {"LL1", "SLR1", "LR1"};
+    shared_ptr<const ParseTable> t;
+    string why;
+    for (int k = 0; k < 3; k++) {
+        t = buildParseTable(g, order[k]);
+        char buf[64];
+        if (t->conflicts.empty()) {
+            if (order[k] == ENGINE_LL1) {
+                snprintf(buf, sizeof(buf), "%s: no conflicts", names[k]);
+            } else {
+                snprintf(buf, sizeof(buf), "%s: no conflicts, %d states", names[k], t->states);
+            }
+            why += buf;
+            why += string(", chose ") + names[k];
+            break;
+        }
+        snprintf(buf, sizeof(buf), "%s: %d conflicts, first ", names[k], (int)t->conflicts.size());
+        why += buf + t->conflicts[0] + "\n";
+        if (order[k] == ENGINE_LR1)
+            why += "grammar is not LR1, chose LR1 and kept the first action of each conflict";
+    }
+    if (reason)
+        *reason = why;
+    return t;
+}
+
+shared_ptr<const ParseTable> updateParseTable(const ParseTable &old, const Grammar &g, unsigned version)
+{
+    vector<char> oldT(old.T.begin(), old.T.end() - 1);
+    bool sameStart = !g.prods.empty() && !old.prods.empty() && g.prods[0].left == old.prods[0].left &&
+                     g.prods[0].rigths == old.prods[0].rigths;
+    if (!old.cache || g.N != old.N || g.T != oldT || (old.engine != ENGINE_LL1 && !sameStart))
+        return buildParseTable(g, old.engine, version);
+    shared_ptr<ParseTable> t = newTable(g, old.engine, version);
+    TableBuilder b(*t);
+    b.old = old.cache.get();
+    /* 按产生式文本对应新旧产生式，相同的产生式按出现顺序对应 */
+    map<string, vector<int> > newIndex;
+    for (int p = g.prods.size() - 1; p >= 0; p--) {
+        newIndex[productionText(g.prods[p])].push_back(p);
+    }
+    for (int p = 0; p < old.prods.size(); p++) {
+        vector<int> &v = newIndex[productionText(old.prods[p])];
+        b.oldToNew.push_back(v.empty() ? -1 : v.back());
+        if (!v.empty())
+            v.pop_back();
+    }
+    b.updateFirstFollow(old.prods);
+    if (old.engine == ENGINE_LL1) {
+        b.buildLL1();
+    } else {
+        b.findReusableStates(old.prods);
+        b.buildLR(old.engine == ENGINE_LR1);
+    }
+    t->cache = b.c;
+    return t;
+}
+
+TableHandle::TableHandle(shared_ptr<const ParseTable> t)
+    : current(t), published(t->version), lastVersion(t->version)
+{
+}
+
+shared_ptr<const ParseTable> TableHandle::load() const
+{
+    return atomic_load(&current);
+}
+
+future<unsigned> TableHandle::rebuild(const Grammar &g, Engine engine)
+{
+    return async(launch::async, [this, g, engine]() {
+        /* 同一时刻只有一个构建，保证版本号按发布顺序递增 */
+        lock_guard<mutex> guard(rebuildLock);
+        shared_ptr<const ParseTable> cur = load();
+        shared_ptr<const ParseTable> t = cur->engine == engine ? updateParseTable(*cur, g, lastVersion + 1)
+                                                               : buildParseTable(g, engine, lastVersion + 1);
+        lastVersion = t->version;
+        /* 先替换分析表再发布版本号，看到新版本号的分析器一定能取到新表 */
+        atomic_store(&current, t);
+        published.store(t->version, memory_order_release);
+        return t->version;
+    });
+}
+
+ResultCache::ResultCache(size_t capacity) : capacity(capacity), hitCount(0), missCount(0)
+{
+}
+
+/* 64位FNV-1a，最后混入版本号 */
+unsigned long long ResultCache::hashKey(unsigned version, const string &input)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    for (int i = 0; i < input.size(); i++) {
+        h = (h ^ (unsigned char)input[i]) * 1099511628211ULL;
+    }
+    return (h ^ version) * 1099511628211ULL;
+}
+
+bool ResultCache::lookup(unsigned version, const string &input, bool &accepted, vector<int> &derivation)
+{
+    unsigned long long key = hashKey(version, input);
+    lock_guard<mutex> guard(lock);
+    auto it = index.find(key);
+    /* 哈希相同还要比较版本号和输入串 */
+    if (it == index.end() || it->second->version != version || it->second->input != input) {
+        missCount.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    /* 移到最前面 */
+    lru.splice(lru.begin(), lru, it->second);
+    accepted = it->second->accepted;
+    derivation.assign(it->second->derivation.begin(), it->second->derivation.end());
+    hitCount.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+void ResultCache::store(unsigned version, const string &input, bool accepted, const vector<int> &derivation)
+{
+    if (capacity == 0)
+        return;
+    Entry e;
+    e.key = hashKey(version, input);
+    e.version = version;
+    e.input = input;
+    e.accepted = accepted;
+    if (accepted) {
+        /* 产生式序号超出16位时不保存 */
+        for (int i = 0; i < derivation.size(); i++) {
+            if (derivation[i] > 0xffff)
+                return;
+        }
+        e.derivation.assign(derivation.begin(), derivation.end());
+    }
+    lock_guard<mutex> guard(lock);
+    auto it = index.find(e.key);
+    if (it != index.end()) {
+        /* 同一个键(或者哈希冲突)，覆盖旧的结果 */
+        *it->second = e;
+        lru.splice(lru.begin(), lru, it->second);
+        return;
+    }
+    if (lru.size() >= capacity) {
+        index.erase(lru.back().key);
+        lru.pop_back();
+    }
+    lru.push_front(e);
+    index[e.key] = lru.begin();
+}
+
+size_t ResultCache::size() const
+{
+    lock_guard<mutex> guard(lock);
+    return lru.size();
+}
+
+Parser::Parser(shared_ptr<const ParseTable> t) : table(t), handle(NULL), results(NULL)
+{
+}
+
+Parser::Parser(const TableHandle &h) : table(h.load()), handle(&h), results(NULL)
+{
+}
+
+bool Parser::parse(const string &input, vector<int> &derivation)
+{
+    if (handle != NULL && handle->currentVersion() != table->version) {
+        table = handle->load();
+    }
+    if (results == NULL)
+        return parseUncached(input, derivation);
+    bool accepted;
+    if (results->lookup(table->version, input, accepted, derivation))
+        return accepted;
+    accepted = parseUncached(input, derivation);
+    results->store(table->version, input, accepted, derivation);
+    return accepted;
+}
+
+bool Parser::parseUncached(const string &input, vector<int> &derivation)
+{
+    const ParseTable &t = *table;
+    derivation.clear();
+    stack.clear();
+    int ip = 0;
+    if (t.engine == ENGINE_LL1) {
+        stack.push_back('$');
+        stack.push_back(t.N[0]);
+        while (1) {
+            char X = stack.back();
+            char a = ip < input.size() ? input[ip] : '$';
+            int j = t.termIndex[(unsigned char)a];
+            if (j < 0 || (a == '$' && ip < input.size()))
+                return false;
+            /* 栈顶是终结符或者$ */
+            if (t.termIndex[(unsigned char)X] >= 0) {
+                if (X != a)
+                    return false;
+                if (X == '$')
+                    return true;
+                stack.pop_back();
+                ip++;
+                continue;
+            }
+            int p = t.M[t.nontermIndex[(unsigned char)X] * t.T.size() + j];
+            if (p < 0)
+                return false;
+            /* 弹栈并将逆序的右部入栈 */
+            stack.pop_back();
+            const pair<int, int> &span = t.rhsSpan[p];
+            for (int k = 0; k < span.second; k++) {
+                stack.push_back(t.rhsPool[span.first + k]);
+            }
+            derivation.push_back(p);
+        }
+    }
+    stack.push_back(0);
+    while (1) {
+        int s = stack.back();
+        char a = ip < input.size() ? input[ip] : '$';
+        int j = t.termIndex[(unsigned char)a];
+        if (j < 0 || (a == '$' && ip < input.size()))
+            return false;
+        const pair<int, int> &act = t.actionAt(s, j);
+        if (act.first == 1) {   // 移进
+            stack.push_back(act.second);
+            ip++;
+        } else if (act.first == 2) {    // 规约
+            int p = act.second;
+            stack.resize(stack.size() - t.rhsLen[p]);
+            int to = t.gotoAt(stack.back(), t.nontermIndex[(unsigned char)t.prods[p].left]);
+            if (to < 0)
+                return false;
+            stack.push_back(to);
+            derivation.push_back(p);
+        } else if (act.first == 3) {    // 接受
+            return true;
+        } else {
+            return false;
+        }
+    }
+}
+
+IncrementalParser::IncrementalParser(shared_ptr<const ParseTable> t)
+    : table(t), accepted(false), reparsed(0)
+{
+}
+
+bool IncrementalParser::parse(const string &s)
+{
+    input = s;
+    if (table->engine == ENGINE_LL1) {
+        Parser p(table);
+        accepted = p.parse(input, derivation);
+        reparsed = input.size();
+        return accepted;
+    }
+    nodes.clear();
+    stackAt.clear();
+    derivAt.clear();
+    derivation.clear();
+    fails.clear();
+    oldStackAt.clear();
+    nodes.push_back(pair<int, int>(0, -1));
+    return run(0, -1, 0);
+}
+
+bool IncrementalParser::edit(int pos, int len, const string &text)
+{
+    if (pos < 0 || len < 0 || pos + len > input.size())
+        return false;
+    /* 旧结点过多时完整分析一次，丢掉不再使用的结点 */
+    if (table->engine == ENGINE_LL1 || nodes.size() > 4 * (input.size() + text.size()) + 1024)
+        return parse(input.substr(0, pos) + text + input.substr(pos + len));
+    input.replace(pos, len, text);
+    /* 修改处之前的部分不变，从读入第pos个符号之前的状态继续，没有分析到pos时从之前最近的位置继续 */
+    int start = min(pos, (int)stackAt.size() - 1);
+    while (stackAt[start] < 0) {
+        start--;
+    }
+    oldStackAt.swap(stackAt);
+    oldDerivAt.swap(derivAt);
+    oldDerivation.swap(derivation);
+    oldFails.swap(fails);
+    stackAt.assign(oldStackAt.begin(), oldStackAt.begin() + start);
+    derivAt.assign(oldDerivAt.begin(), oldDerivAt.begin() + start);
+    derivation.assign(oldDerivation.begin(), oldDerivation.begin() + oldDerivAt[start]);
+    /* start之前的错误仍然存在 */
+    fails.clear();
+    for (int k = 0; k < oldFails.size() && oldFails[k] < start; k++) {
+        fails.push_back(oldFails[k]);
+    }
+    return run(start, pos + text.size(), text.size() - len);
+}
+
+/* 比较两个状态栈，共享的结点不再往下比较 */
+bool IncrementalParser::sameStack(int a, int b) const
+{
+    while (a != b) {
+        if (a < 0 || b < 0 || nodes[a].first != nodes[b].first)
+            return false;
+        a = nodes[a].second;
+        b = nodes[b].second;
+    }
+    return true;
+}
+
+/* 从第from个位置开始接上旧分析在对应位置(减去delta)的结果，修改范围内的位置记为没有分析到 */
+void IncrementalParser::keepTail(int from, int matchFrom, int delta)
+{
+    int k = from;
+    for (; k < matchFrom || k - delta < 0; k++) {
+        if (k - delta >= (int)oldStackAt.size())
+            return;
+        stackAt.push_back(-1);
+        derivAt.push_back(derivation.size());
+    }
+    int old = k - delta;
+    if (old >= oldStackAt.size())
+        return;
+    int shift = (int)derivation.size() - oldDerivAt[old];
+    derivation.insert(derivation.end(), oldDerivation.begin() + oldDerivAt[old], oldDerivation.end());
+    for (int f = 0; f < oldFails.size(); f++) {
+        if (oldFails[f] >= old)
+            fails.push_back(oldFails[f] + delta);
+    }
+    stackAt.insert(stackAt.end(), oldStackAt.begin() + old, oldStackAt.end());
+    int n = derivAt.size();
+    derivAt.insert(derivAt.end(), oldDerivAt.begin() + old, oldDerivAt.end());
+    for (int i = n; i < derivAt.size(); i++) {
+        derivAt[i] += shift;
+    }
+}
+
+/* 从第ip个输入符号继续分析，没有旧分析时栈顶为初始状态，否则为旧分析在ip的栈顶。
+ * 到达matchFrom及之后的位置时，与旧分析中对应的位置(减去delta)比较状态栈，相同时沿用旧结果 */
+bool IncrementalParser::run(int ip, int matchFrom, int delta)
+{
+    const ParseTable &t = *table;
+    int top = matchFrom >= 0 ? oldStackAt[ip] : 0;
+    int begin = ip;
+    bool record = true;
+    while (1) {
+        if (record) {
+            int old = ip - delta;
+            if (matchFrom >= 0 && ip >= matchFrom && old < oldStackAt.size() && oldStackAt[old] >= 0 &&
+                sameStack(top, oldStackAt[old])) {
+                /* 余下的分析与旧分析相同 */
+                keepTail(ip, matchFrom, delta);
+                accepted = fails.empty();
+                reparsed = ip - begin;
+                return accepted;
+            }
+            stackAt.push_back(top);
+            derivAt.push_back(derivation.size());
+            record = false;
+        }
+        char a = ip < input.size() ? input[ip] : '$';
+        int j = t.termIndex[(unsigned char)a];
+        reparsed = ip - begin + 1;
+        bool fail = j < 0 || (a == '$' && ip < input.size());
+        const pair<int, int> &act = fail ? pair<int, int>(0, 0) : t.actionAt(nodes[top].first, j);
+        if (act.first == 1) {   // 移进
+            nodes.push_back(pair<int, int>(act.second, top));
+            top = nodes.size() - 1;
+            ip++;
+            record = true;
+            continue;
+        } else if (act.first == 2) {    // 规约
+            int p = act.second;
+            for (int k = 0; k < t.rhsLen[p]; k++) {
+                top = nodes[top].second;
+            }
+            int to = t.gotoAt(nodes[top].first, t.nontermIndex[(unsigned char)t.prods[p].left]);
+            if (to >= 0) {
+                nodes.push_back(pair<int, int>(to, top));
+                top = nodes.size() - 1;
+                derivation.push_back(p);
+                continue;
+            }
+        } else if (act.first == 3) {    // 接受
+            accepted = fails.empty();
+            return accepted;
+        }
+        /* 出错，保留出错处之后旧分析的结果 */
+        fails.push_back(ip);
+        if (matchFrom >= 0)
+            keepTail(ip + 1, matchFrom, delta);
+        accepted = false;
+        return false;
+    }
+}
+
+/* 从状态栈st开始分析input的[ip, end)，end为输入长度时还要读入$。
+ * 返回1表示分析完这一段，2表示接受，0表示出错 */
+static int runLR(const ParseTable &t, const string &input, int ip, int end, vector<int> &st, vector<int> &derivation)
+{
+    bool last = end == input.size();
+    while (ip < end || last) {
+        char a = ip < input.size() ? input[ip] : '$';
+        int j = t.termIndex[(unsigned char)a];
+        if (j < 0 || (a == '$' && ip < input.size()))
+            return 0;
+        const pair<int, int> &act = t.actionAt(st.back(), j);
+        if (act.first == 1) {   // 移进
+            st.push_back(act.second);
+            ip++;
+        } else if (act.first == 2) {    // 规约
+            int p = act.second;
+            st.resize(st.size() - t.rhsLen[p]);
+            int to = t.gotoAt(st.back(), t.nontermIndex[(unsigned char)t.prods[p].left]);
+            if (to < 0)
+                return 0;
+            st.push_back(to);
+            derivation.push_back(p);
+        } else if (act.first == 3) {    // 接受
+            return 2;
+        } else {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* 一块的推测分析结果 */
+struct Speculation {
+    bool ok;
+    int result;                 // 同runLR
+    vector<int> assumed;        // 分析中用到的假定的状态栈顶部，从下到上
+    vector<int> stack;          // 分析后假定部分换成的状态，从下到上
+    vector<int> derivation;
+};
+
+/* 由开头一段顺序分析统计出的猜测依据 */
+struct Guesses {
+    /* 输入位置及之前若干个符号 -> 读入该位置之前的状态栈顶部(从下到上)，按出现次数从多到少 */
+    map<string, vector< vector<int> > > tops;
+    vector<int> below;          // 每个状态下面最常见的状态，-1表示没有见过
+};
+
+/* 猜测时参考的上下文长度，先用长的，没有见过时用短的 */
+static const int contextLengths[] = {8, 2};
+/* 记录的状态栈顶部的长度 */
+static const int suffixLength = 8;
+/* 统计猜测依据时顺序分析的符号数。统计比分析慢得多，只取固定的一小段，并且与第0块的分析同时进行 */
+static const int guessSample = 4096;
+
+static string contextKey(const string &input, int ip, int w)
+{
+    int from = max(0, ip - w + 1);
+    return string(1, (char)w) + input.substr(from, ip + 1 - from);
+}
+
+/* 顺序分析开头最多sample个符号，统计每个位置的状态栈顶部和栈顶附近每个状态下面的状态 */
+static void collectGuesses(const ParseTable &t, const string &input, int sample, Guesses &g)
+{
+    vector< map<int, int> > belowCount(t.states);
+    map<string, map<vector<int>, int> > topCount;
+    vector<int> st(1, 0);
+    vector<int> derivation;
+    for (int ip = 0; ip < sample && ip < input.size(); ip++) {
+        vector<int> suffix(st.end() - min((int)st.size(), suffixLength), st.end());
+        for (int k = 0; k < sizeof(contextLengths) / sizeof(int); k++) {
+            topCount[contextKey(input, ip, contextLengths[k])][suffix]++;
+        }
+        if (runLR(t, input, ip, ip + 1, st, derivation) != 1)
+            break;
+        for (int k = max(1, (int)st.size() - suffixLength); k < st.size(); k++) {
+            belowCount[st[k]][st[k - 1]]++;
+        }
+        derivation.clear();
+    }
+    g.below.assign(t.states, -1);
+    for (int s = 0; s < t.states; s++) {
+        int best = 0;
+        for (auto it = belowCount[s].begin(); it != belowCount[s].end(); it++) {
+            if (it->second > best) {
+                best = it->second;
+                g.below[s] = it->first;
+            }
+        }
+    }
+    for (auto it = topCount.begin(); it != topCount.end(); it++) {
+        vector< pair<int, vector<int> > > v;
+        for (auto c = it->second.begin(); c != it->second.end(); c++) {
+            v.push_back(pair<int, vector<int> >(-c->second, c->first));
+        }
+        sort(v.begin(), v.end());
+        for (int k = 0; k < v.size(); k++) {
+            g.tops[it->first].push_back(v[k].second);
+        }
+    }
+}
+
+/* 从假定的状态栈顶部init开始推测分析[ip, end)，弹出假定部分的栈底时按g.below继续猜测下面的状态 */
+static void speculate(const ParseTable &t, const string &input, int ip, int end, const vector<int> &init,
+                      const Guesses &g, Speculation &r)
+{
+    /* st[lo..]为当前的栈，前面留出空位，猜测的状态从lo往前放；
+     * orig与st下标相同，保存假定的状态，low为分析中读到的最低位置 */
+    int head = 64;
+    vector<int> st(head, 0);
+    st.insert(st.end(), init.begin(), init.end());
+    vector<int> orig = st;
+    int lo = head;
+    int low = st.size() - 1;
+    int origTop = low;
+    bool last = end == input.size();
+    r.ok = false;
+    r.result = 0;
+    r.derivation.clear();
+    while (ip < end || last) {
+        char a = ip < input.size() ? input[ip] : '$';
+        int j = t.termIndex[(unsigned char)a];
+        if (j < 0 || (a == '$' && ip < input.size()))
+            return;
+        const pair<int, int> &act = t.actionAt(st.back(), j);
+        if (act.first == 1) {
+            st.push_back(act.second);
+            ip++;
+        } else if (act.first == 2) {
+            int p = act.second;
+            int top = (int)st.size() - 1 - t.rhsLen[p];
+            /* 弹出了假定部分的栈底，猜测下面的状态 */
+            while (top < lo) {
+                int b = g.below[orig[lo]];
+                if (b < 0)
+                    return;
+                if (lo == 0) {
+                    st.insert(st.begin(), head, 0);
+                    orig.insert(orig.begin(), head, 0);
+                    lo += head;
+                    top += head;
+                    low += head;
+                    origTop += head;
+                }
+                lo--;
+                st[lo] = orig[lo] = b;
+            }
+            low = min(low, top);
+            st.resize(top + 1);
+            int to = t.gotoAt(st.back(), t.nontermIndex[(unsigned char)t.prods[p].left]);
+            if (to < 0)
+                return;
+            st.push_back(to);
+            r.derivation.push_back(p);
+        } else if (act.first == 3) {
+            r.result = 2;
+            break;
+        } else {
+            return;
+        }
+    }
+    if (r.result == 0)
+        r.result = 1;
+    r.ok = true;
+    r.assumed.assign(orig.begin() + low, orig.begin() + origTop + 1);
+    r.stack.assign(st.begin() + low, st.end());
+}
+
+/* 当前线程的CPU时间(微秒) */
+static double threadCpuUs()
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+#else
+    return chrono::duration<double, micro>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+double ParallelStats::criticalUs() const
+{
+    if (chunkUs.empty())
+        return spliceUs;
+    double rest = 0;
+    for (int i = 1; i < chunkUs.size(); i++) {
+        rest = max(rest, chunkUs[i]);
+    }
+    return max(chunkUs[0], sampleUs + rest) + spliceUs;
+}
+
+bool parseParallel(shared_ptr<const ParseTable> table, const string &input, vector<int> &derivation, int threads,
+                   ParallelStats *stats)
+{
+    const ParseTable &t = *table;
+    derivation.clear();
+    ParallelStats local;
+    ParallelStats &ps = stats ? *stats : local;
+    ps.hits = 0;
+    ps.sampleUs = ps.spliceUs = 0;
+    ps.chunkUs.clear();
+    if (t.engine == ENGINE_LL1 || threads <= 1 || input.size() < 64 * threads) {
+        Parser p(table);
+        return p.parse(input, derivation);
+    }
+    vector<int> bound(threads + 1);
+    for (int i = 0; i <= threads; i++) {
+        bound[i] = (long long)input.size() * i / threads;
+    }
+    vector<Speculation> spec(threads);
+    vector<thread> workers;
+    ps.chunkUs.assign(threads, 0);
+    /* 第0块从初始状态开始，直接是真实的结果，不需要猜测，先开始分析 */
+    workers.push_back(thread([&]() {
+        double begin = threadCpuUs();
+        Speculation &r = spec[0];
+        vector<int> st(1, 0);
+        r.result = runLR(t, input, 0, bound[1], st, r.derivation);
+        r.ok = true;
+        r.assumed.assign(1, 0);
+        r.stack = st;
+        ps.chunkUs[0] = threadCpuUs() - begin;
+    }));
+    double begin = threadCpuUs();
+    Guesses g;
+    collectGuesses(t, input, min(bound[1], guessSample), g);
+    ps.sampleUs = threadCpuUs() - begin;
+    for (int i = 1; i < threads; i++) {
+        workers.push_back(thread([&, i]() {
+            double begin = threadCpuUs();
+            Speculation &r = spec[i];
+            int b = bound[i];
+            r.ok = false;
+            /* 依次尝试最常见的几个状态栈顶部，直到某个能分析完这一块 */
+            for (int c = 0; c < sizeof(contextLengths) / sizeof(int) && !r.ok; c++) {
+                auto it = g.tops.find(contextKey(input, b, contextLengths[c]));
+                for (int k = 0; it != g.tops.end() && k < it->second.size() && k < 3 && !r.ok; k++) {
+                    speculate(t, input, b, bound[i + 1], it->second[k], g, r);
+                }
+            }
+            ps.chunkUs[i] = threadCpuUs() - begin;
+        }));
+    }
+    for (int i = 0; i < threads; i++) {
+        workers[i].join();
+    }
+    begin = threadCpuUs();
+    /* 按顺序拼接，推导先按各块的长度一次分配好 */
+    size_t total = 0;
+    for (int i = 0; i < threads; i++) {
+        total += spec[i].derivation.size();
+    }
+    derivation.reserve(total);
+    vector<int> st;
+    int result = 1;
+    for (int i = 0; i < threads && result == 1; i++) {
+        Speculation &r = spec[i];
+        if (i == 0) {
+            st.swap(r.stack);
+            derivation.insert(derivation.end(), r.derivation.begin(), r.derivation.end());
+            result = r.result;
+            continue;
+        }
+        int n = r.assumed.size();
+        if (r.ok && st.size() >= n && equal(r.assumed.begin(), r.assumed.end(), st.end() - n)) {
+            st.resize(st.size() - n);
+            st.insert(st.end(), r.stack.begin(), r.stack.end());
+            derivation.insert(derivation.end(), r.derivation.begin(), r.derivation.end());
+            result = r.result;
+            ps.hits++;
+        } else {
+            result = runLR(t, input, bound[i], bound[i + 1], st, derivation);
+        }
+    }
+    ps.spliceUs = threadCpuUs() - begin;
+    return result == 2;
+}
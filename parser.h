@@ -0,0 +1,241 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <istream>
+#include <atomic>
+#include <mutex>
+#include <future>
+#include <list>
+#include <unordered_map>
+#include "precedence.h"
+
+/* 语法分析库：文法构造器Grammar、编译后只读的分析表ParseTable和轻量的分析器Parser。
+ * 所有状态都保存在对象中，一个进程中可以同时存在多个文法；分析表构建后不再修改，
+ * 可以被多个线程中的多个Parser同时使用 */
+
+/* 分析方法 */
+enum Engine {
+    ENGINE_LL1,
+    ENGINE_SLR1,
+    ENGINE_LR1
+};
+
+/* 产生式结构体，左部符号和右部符号串 */
+struct Production {
+    char left;
+    std::vector<char> rigths;
+};
+
+/* 文法构造器，文法符号均为单个字符，&表示空 */
+struct Grammar {
+    std::vector<Production> prods;  // 产生式，LR分析时第一个产生式为拓广文法的开始产生式
+    std::vector<char> N;            // 非终结符，第一个为开始符号
+    std::vector<char> T;            // 终结符，不含$
+    Precedence prec;                // 优先级声明，SLR1和LR1用来解决移进-规约冲突
+
+    /* 加入形如"E->E+T"的产生式 */
+    Grammar &production(const std::string &s);
+    /* 加入非终结符 */
+    Grammar &nonterminals(const std::string &s);
+    /* 加入终结符 */
+    Grammar &terminals(const std::string &s);
+    /* 加入形如"%left + -"的优先级声明，后加入的优先级高 */
+    Grammar &precedence(const std::string &s);
+};
+
+/* 按原程序的输入格式(产生式数量、产生式、以#结尾的非终结符和终结符，以及可选的优先级声明)读入文法 */
+bool readGrammar(std::istream &in, Grammar &g);
+
+/* 构建分析表时的中间结果(FIRST集、FOLLOW集、项目集规范族)，增量更新时使用 */
+struct BuildCache;
+
+/* 编译好的分析表，构建后只读 */
+struct ParseTable {
+    Engine engine;
+    unsigned version;               // 版本号，由TableHandle发布时递增
+    std::vector<Production> prods;
+    std::vector<char> T;            // 终结符，最后一个为$
+    std::vector<char> N;            // 非终结符
+    int termIndex[256];             // 字符在T中的下标，-1表示不是终结符
+    int nontermIndex[256];          // 字符在N中的下标，-1表示不是非终结符
+    std::vector<int> rhsLen;        // 每个产生式右部的长度，空产生式为0
+    Precedence prec;                // 文法的优先级声明
+
+    /* LR分析表，first表示分析动作，0->出错 1->S 2->R 3->ACC，second表示转移状态或者产生式序号 */
+    int states;
+    std::vector< std::pair<int, int> > action;  // states * T.size()
+    std::vector<int> go;                        // states * N.size()，-1表示没有转移
+
+    /* LL1预测分析表，保存产生式序号，-1表示空 */
+    std::vector<int> M;                         // N.size() * T.size()
+    /* 每个产生式去掉空后逆序的右部，第i个产生式为rhsPool[rhsSpan[i].first]开始的rhsSpan[i].second个符号 */
+    std::vector<char> rhsPool;
+    std::vector< std::pair<int, int> > rhsSpan;
+
+    /* 构建时发现的冲突，有冲突时表项保留先填入的动作。按优先级解决的冲突不在其中 */
+    std::vector<std::string> conflicts;
+
+    std::shared_ptr<const BuildCache> cache;
+
+    const std::pair<int, int> &actionAt(int s, int j) const
+    {
+        return action[s * T.size() + j];
+    }
+    int gotoAt(int s, int j) const
+    {
+        return go[s * N.size() + j];
+    }
+};
+
+/* 由文法构建指定方法的分析表 */
+std::shared_ptr<const ParseTable> buildParseTable(const Grammar &g, Engine engine, unsigned version = 0);
+
+/* 按代价从低到高(LL1、SLR1、LR1)依次构建分析表，返回第一个没有冲突的；三种都有冲突时返回LR1的分析表。
+ * reason不为空时写入每种方法的冲突情况和最后的选择 */
+std::shared_ptr<const ParseTable> buildCheapestParseTable(const Grammar &g, std::string *reason = NULL);
+
+/* 文法增删产生式后，由旧分析表增量构建新文法的分析表，结果与buildParseTable完全相同。
+ * 只重新计算受影响的非终结符的FIRST集和FOLLOW集，以及闭包中用到受影响的非终结符的LR状态，
+ * 其余状态直接沿用旧的闭包。非终结符、终结符或者拓广文法的开始产生式变化时完整重建 */
+std::shared_ptr<const ParseTable> updateParseTable(const ParseTable &old, const Grammar &g, unsigned version = 0);
+
+/* 可以热替换的分析表句柄。每个版本的分析表构建后只读，由shared_ptr计数，
+ * 正在进行的分析继续使用旧版本，旧版本在最后一个使用者结束后释放。
+ * 新版本在后台构建，构建完成后原子地替换当前版本，分析线程不需要加锁 */
+class TableHandle {
+public:
+    explicit TableHandle(std::shared_ptr<const ParseTable> t);
+    /* 当前版本的分析表 */
+    std::shared_ptr<const ParseTable> load() const;
+    /* 当前版本号，只读一个整数，用于分析器判断是否需要换用新版本 */
+    unsigned currentVersion() const
+    {
+        return published.load(std::memory_order_acquire);
+    }
+    /* 在后台由新文法构建分析表并替换当前版本，返回新版本号。分析方法不变时在当前版本上增量构建 */
+    std::future<unsigned> rebuild(const Grammar &g, Engine engine);
+
+private:
+    std::shared_ptr<const ParseTable> current;  // 只通过atomic_load/atomic_store访问
+    std::atomic<unsigned> published;
+    unsigned lastVersion;                       // 已分配的最大版本号，由rebuildLock保护
+    std::mutex rebuildLock;                     // 只串行化构建，分析线程不使用
+
+    TableHandle(const TableHandle &);
+    TableHandle &operator=(const TableHandle &);
+};
+
+/* 分析结果缓存：以(分析表版本号, 输入串)的哈希为键，保存是否接受和16位压缩的推导，
+ * 最多保存capacity个结果，满了以后淘汰最近最少使用的。版本号不同的结果互不命中，热替换后旧结果自然被淘汰。
+ * 每个文法使用自己的缓存，多个线程的分析器可以共享同一个缓存 */
+class ResultCache {
+public:
+    explicit ResultCache(size_t capacity);
+    /* 命中时填入结果并返回true，接受时derivation与Parser::parse相同 */
+    bool lookup(unsigned version, const std::string &input, bool &accepted, std::vector<int> &derivation);
+    /* 保存一次分析的结果，不接受时不保存推导 */
+    void store(unsigned version, const std::string &input, bool accepted, const std::vector<int> &derivation);
+    unsigned long long hits() const
+    {
+        return hitCount.load(std::memory_order_relaxed);
+    }
+    unsigned long long misses() const
+    {
+        return missCount.load(std::memory_order_relaxed);
+    }
+    /* 当前保存的结果数 */
+    size_t size() const;
+private:
+    struct Entry {
+        unsigned long long key;
+        unsigned version;
+        std::string input;
+        bool accepted;
+        std::vector<unsigned short> derivation;
+    };
+    size_t capacity;
+    std::list<Entry> lru;           // 最近使用的在前
+    std::unordered_map<unsigned long long, std::list<Entry>::iterator> index;
+    mutable std::mutex lock;
+    std::atomic<unsigned long long> hitCount, missCount;
+    static unsigned long long hashKey(unsigned version, const std::string &input);
+    ResultCache(const ResultCache &);
+    ResultCache &operator=(const ResultCache &);
+};
+
+/* 分析器，只保存分析用到的栈，可以重复使用，不同线程使用不同的分析器 */
+struct Parser {
+    std::shared_ptr<const ParseTable> table;
+    const TableHandle *handle;      // 不为空时每次分析前检查是否有新版本
+    ResultCache *results;           // 不为空时先查缓存，没有命中才分析并保存结果
+    std::vector<int> stack;
+
+    explicit Parser(std::shared_ptr<const ParseTable> t);
+    explicit Parser(const TableHandle &h);
+    /* 分析input(不含$)，接受时返回true。derivation保存所用产生式的序号：
+     * LL1为最左推导的顺序，SLR1和LR1为最右推导的逆序。
+     * 使用句柄时一次分析从头到尾使用同一个版本的分析表 */
+    bool parse(const std::string &input, std::vector<int> &derivation);
+private:
+    bool parseUncached(const std::string &input, std::vector<int> &derivation);
+};
+
+/* 增量分析器。保存上一次分析在每个输入位置之前的状态栈和推导长度，各个位置的状态栈共享结点。
+ * 修改输入后从修改处之前的位置继续分析，越过修改处后，一旦状态栈与旧分析在对应位置的状态栈相同，
+ * 余下的分析不会有任何不同，直接沿用旧的状态栈和推导。
+ * 分析出错时保留出错处之后旧分析的结果，改正错误后仍然可以沿用。LL1分析表每次完整分析 */
+struct IncrementalParser {
+    std::shared_ptr<const ParseTable> table;
+    std::string input;
+    bool accepted;
+    std::vector<int> derivation;    // 接受时与Parser::parse相同
+    int reparsed;                   // 最近一次分析实际读入的输入符号数
+
+    explicit IncrementalParser(std::shared_ptr<const ParseTable> t);
+    /* 完整分析s */
+    bool parse(const std::string &s);
+    /* 把input中从pos开始的len个字符换成text并重新分析 */
+    bool edit(int pos, int len, const std::string &text);
+
+private:
+    std::vector< std::pair<int, int> > nodes;   // 状态栈结点(状态, 下面一个结点)，-1表示栈底
+    std::vector<int> stackAt;                   // 读入第i个输入符号之前的栈顶结点，-1表示没有分析到
+    std::vector<int> derivAt;                   // 读入第i个输入符号之前的推导长度
+    std::vector<int> fails;                     // 分析出错的位置，从小到大
+    /* 旧分析的结果，重新分析时用来比较和沿用 */
+    std::vector<int> oldStackAt;
+    std::vector<int> oldDerivAt;
+    std::vector<int> oldDerivation;
+    std::vector<int> oldFails;
+
+    bool sameStack(int a, int b) const;
+    bool run(int ip, int matchFrom, int delta);
+    void keepTail(int from, int matchFrom, int delta);
+};
+
+/* 并行分析一个很长的输入(SLR1、LR1)。输入分成threads块，第0块分析的同时顺序分析开头固定的一小段，统计每对相邻符号
+ * 之间最常见的栈顶状态和每个状态下面最常见的状态；之后每块从猜测的栈顶状态开始推测分析，
+ * 规约弹出猜测的栈底时继续猜测下面的状态。最后按顺序拼接：只有当前的真实状态栈顶部与某块推测时
+ * 假定的状态完全相同时才采用该块的结果，否则从真实状态栈顺序分析该块。
+ * 返回值与Parser::parse相同，接受时derivation也相同。stats不为空时返回各阶段的耗时 */
+struct ParallelStats;
+bool parseParallel(std::shared_ptr<const ParseTable> t, const std::string &input, std::vector<int> &derivation,
+                   int threads, ParallelStats *stats = NULL);
+
+/* parseParallel各阶段所在线程的CPU时间(微秒)，线程多于核数时不计入等待，单核机器上也能估计多核上的耗时 */
+struct ParallelStats {
+    int hits;                       // 推测被采用的块数
+    double sampleUs;                // 统计猜测依据，与第0块的分析同时进行
+    std::vector<double> chunkUs;    // 每块的分析，第0块以外为推测分析
+    double spliceUs;                // 拼接，包括推测错误的块的重新分析
+    /* 每块一个核时的耗时：第0块与统计后的其余各块同时分析，之后拼接 */
+    double criticalUs() const;
+};
+
+/* 把产生式写成"A->..."的形式 */
+std::string productionText(const Production &P);
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef PRECEDENCE_H
+#define PRECEDENCE_H
+
+#include <algorithm>
+#include <istream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* SLR1、LR1两个分析程序和语法分析库共用的优先级声明，用于解决移进-规约冲突 */
+
+const int ASSOC_LEFT = 0, ASSOC_RIGHT = 1, ASSOC_NONASSOC = 2;
+
+/* 终结符的优先级(后声明的高，未声明的没有)和结合性 */
+struct Precedence {
+    std::map<char, int> level;
+    std::map<char, int> assoc;
+
+    /* 读入可选的优先级声明，每行为"%left/%right/%nonassoc 终结符... #"，后声明的优先级高 */
+    void read(std::istream &in)
+    {
+        std::string s;
+        char ch;
+        /* 接在已有的声明之后 */
+        int l = 1;
+        for (std::map<char, int>::iterator it = level.begin(); it != level.end(); it++) {
+            l = std::max(l, it->second + 1);
+        }
+        in >> std::ws;
+        for (; in.peek() == '%'; l++) {
+            in >> s;
+            int a = s == "%right" ? ASSOC_RIGHT : (s == "%nonassoc" ? ASSOC_NONASSOC : ASSOC_LEFT);
+            while (in >> ch && ch != '#') {
+                level[ch] = l;
+                assoc[ch] = a;
+            }
+            in >> std::ws;
+        }
+    }
+
+    /* 产生式的优先级为右部最后一个声明了优先级的终结符的优先级，没有时为0。
+     * Production需要有vector<char> rigths */
+    template <class Production>
+    int ofProduction(const Production &P) const
+    {
+        for (int k = P.rigths.size() - 1; k >= 0; k--) {
+            std::map<char, int>::const_iterator it = level.find(P.rigths[k]);
+            if (it != level.end())
+                return it->second;
+        }
+        return 0;
+    }
+
+    /* 按优先级和结合性解决遇到终结符a时的全部动作acts中的移进-规约冲突(动作1为移进，2为规约)。
+     * 与yacc相同，移进分别与每个规约比较：产生式优先级高则去掉移进，低则去掉规约，相同时左结合去掉移进、
+     * 右结合去掉规约、不结合两个都去掉；任一方没有优先级时两个都保留。剩下的多个规约仍是规约-规约冲突，
+     * 全部去掉时该表项出错。有动作被去掉时返回true */
+    template <class Production>
+    bool resolve(std::vector< std::pair<int, int> > &acts, char a, const std::vector<Production> &prods) const
+    {
+        int s = -1;
+        for (int k = 0; k < acts.size(); k++) {
+            if (acts[k].first == 1)
+                s = k;
+        }
+        std::map<char, int>::const_iterator it = level.find(a);
+        if (s < 0 || acts.size() < 2 || it == level.end())
+            return false;
+        int pa = it->second, as = assoc.find(a)->second;
+        std::vector<bool> drop(acts.size(), false);
+        for (int k = 0; k < acts.size(); k++) {
+            if (acts[k].first != 2)
+                continue;
+            int pp = ofProduction(prods[acts[k].second]);
+            if (pp == 0)
+                continue;
+            if (pp > pa || (pp == pa && as == ASSOC_LEFT)) {
+                drop[s] = true;
+            } else if (pp < pa || as == ASSOC_RIGHT) {
+                drop[k] = true;
+            } else {
+                drop[s] = drop[k] = true;
+            }
+        }
+        std::vector< std::pair<int, int> > kept;
+        for (int k = 0; k < acts.size(); k++) {
+            if (!drop[k])
+                kept.push_back(acts[k]);
+        }
+        if (kept.size() == acts.size())
+            return false;
+        acts = kept;
+        return true;
+    }
+};
+
+#endif
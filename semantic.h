@@ -0,0 +1,143 @@
+#ifndef SEMANTIC_H
+#define SEMANTIC_H
+
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+/* LL1、SLR1、LR1三个分析程序共用的语义动作和值栈 */
+
+/* 语义动作，v[i]为产生式右部第i个符号的值，返回左部的值 */
+typedef double (*SemanticAction)(const double *v);
+
+inline double semFirst(const double *v) { return v[0]; }
+inline double semZero(const double *) { return 0; }
+inline double semOne(const double *) { return 1; }
+inline double semParen(const double *v) { return v[1]; }
+inline double semAdd(const double *v) { return v[0] + v[2]; }
+inline double semSub(const double *v) { return v[0] - v[2]; }
+inline double semMul(const double *v) { return v[0] * v[2]; }
+inline double semDiv(const double *v) { return v[0] / v[2]; }
+/* 消除左递归后的文法(1.in)：A、B的值为后面各项之和、各因子之积 */
+inline double semSum(const double *v) { return v[0] + v[1]; }
+inline double semProduct(const double *v) { return v[0] * v[1]; }
+inline double semAddRest(const double *v) { return v[1] + v[2]; }
+inline double semSubRest(const double *v) { return v[2] - v[1]; }
+inline double semMulRest(const double *v) { return v[1] * v[2]; }
+inline double semDivRest(const double *v) { return v[2] / v[1]; }
+
+/* 值栈，与分析栈同步：移进时压入符号的值，规约时执行语义动作 */
+struct ValueStack {
+    /* 按产生式文本注册的语义动作 */
+    std::map<std::string, SemanticAction> rules;
+    /* semantic[i]为第i个产生式的语义动作，读入文法后由rules查出，分析时直接调用 */
+    std::vector<SemanticAction> semantic;
+    /* 输入串各个位置上符号的值，数字为其数值，其他符号为0 */
+    std::vector<double> tokenValue;
+    /* 按输入长度预先分配，vtop为栈中值的个数 */
+    std::vector<double> VS;
+    int vtop;
+
+    ValueStack() : vtop(0) {}
+
+    /* 注册四则运算文法(1.in、2.in、4.in)的语义动作 */
+    void registerArithmetic()
+    {
+        rules["E->E+T"] = semAdd;
+        rules["E->E-T"] = semSub;
+        rules["T->T*F"] = semMul;
+        rules["T->T/F"] = semDiv;
+        rules["F->(E)"] = semParen;
+        /* 带优先级声明的单层文法(4.in) */
+        rules["E->E+E"] = semAdd;
+        rules["E->E-E"] = semSub;
+        rules["E->E*E"] = semMul;
+        rules["E->E/E"] = semDiv;
+        rules["E->(E)"] = semParen;
+        rules["E->TA"] = semSum;
+        rules["A->+TA"] = semAddRest;
+        rules["A->-TA"] = semSubRest;
+        rules["A->&"] = semZero;
+        rules["T->FB"] = semProduct;
+        rules["B->*FB"] = semMulRest;
+        rules["B->/FB"] = semDivRest;
+        rules["B->&"] = semOne;
+    }
+
+    /* 查出每个产生式的语义动作，没有注册的产生式取右部第一个符号的值，空产生式为0。
+     * Production需要有char left和vector<char> rigths */
+    template <class Production>
+    void bind(const std::vector<Production> &prods)
+    {
+        semantic.clear();
+        for (int i = 0; i < prods.size(); i++) {
+            const Production &P = prods[i];
+            std::string s = std::string(1, P.left) + "->" + std::string(P.rigths.begin(), P.rigths.end());
+            std::map<std::string, SemanticAction>::iterator it = rules.find(s);
+            if (it != rules.end()) {
+                semantic.push_back(it->second);
+            } else {
+                semantic.push_back(P.rigths.empty() || P.rigths[0] == '&' ? semZero : semFirst);
+            }
+        }
+    }
+
+    /* 把输入串中的数字换成终结符n并记下其值，按输入长度分配值栈 */
+    void lexNumbers(std::string &str)
+    {
+        std::string s;
+        tokenValue.clear();
+        for (int i = 0; i < str.size(); i++) {
+            if (isdigit(str[i]) || str[i] == '.') {
+                int j = i;
+                while (j < str.size() && (isdigit(str[j]) || str[j] == '.')) {
+                    j++;
+                }
+                s += 'n';
+                tokenValue.push_back(atof(str.substr(i, j - i).c_str()));
+                i = j - 1;
+            } else {
+                s += str[i];
+                tokenValue.push_back(0);
+            }
+        }
+        str = s;
+        VS.resize(str.size() + 16);
+        vtop = 0;
+    }
+
+    /* 压入输入串第ip个符号的值，超出预先分配的空间时才扩充 */
+    void shift(int ip)
+    {
+        if (vtop >= VS.size()) {
+            VS.resize(VS.size() * 2);
+        }
+        VS[vtop++] = tokenValue[ip];
+    }
+
+    /* 执行第p个产生式的语义动作：弹出右部n个符号的值，压入左部的值 */
+    void reduce(int p, int n)
+    {
+        vtop -= n;
+        if (vtop >= VS.size()) {
+            VS.resize(VS.size() * 2);
+        }
+        VS[vtop] = semantic[p](&VS[vtop]);
+        vtop++;
+    }
+
+    bool empty() const
+    {
+        return vtop == 0;
+    }
+
+    /* 栈顶的值，接受时为整个输入的值 */
+    double top() const
+    {
+        return VS[vtop - 1];
+    }
+};
+
+#endif
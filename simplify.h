@@ -0,0 +1,100 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <cstdio>
+#include <set>
+#include <string>
+
+/* LL1、SLR1、LR1三个分析程序共用的文法化简。Grammar需要有num、N、T和prods，
+ * 产生式需要有char left和vector<char> rigths */
+
+/* 文法化简：先求出能推出终结符串的(有用的)非终结符，再只经过有用的产生式求出从开始符号可达的符号，
+ * 删去含有无用符号或左部不可达的产生式以及无用、不可达的符号，剩下的按原来的顺序重新编号 */
+template <class Grammar>
+void reduceGrammar(Grammar &grammar)
+{
+    std::set<char> nonterm(grammar.N.begin(), grammar.N.end());
+    /* 右部全是终结符、空或已知有用的非终结符，左部就是有用的 */
+    std::set<char> productive;
+    bool change = true;
+    while (change) {
+        change = false;
+        for (int i = 0; i < grammar.prods.size(); i++) {
+            auto &P = grammar.prods[i];
+            if (productive.count(P.left))
+                continue;
+            bool ok = true;
+            for (int k = 0; k < P.rigths.size() && ok; k++) {
+                ok = !nonterm.count(P.rigths[k]) || productive.count(P.rigths[k]);
+            }
+            if (ok) {
+                productive.insert(P.left);
+                change = true;
+            }
+        }
+    }
+    if (!productive.count(grammar.N[0])) {
+        printf("reduce: %c derives no terminal string, grammar left unchanged\n", grammar.N[0]);
+        return;
+    }
+    /* 只经过右部全部有用的产生式求可达的符号 */
+    std::set<char> reachable;
+    reachable.insert(grammar.N[0]);
+    change = true;
+    while (change) {
+        change = false;
+        for (int i = 0; i < grammar.prods.size(); i++) {
+            auto &P = grammar.prods[i];
+            if (!reachable.count(P.left))
+                continue;
+            bool ok = true;
+            for (int k = 0; k < P.rigths.size() && ok; k++) {
+                ok = !nonterm.count(P.rigths[k]) || productive.count(P.rigths[k]);
+            }
+            for (int k = 0; k < P.rigths.size() && ok; k++) {
+                if (reachable.insert(P.rigths[k]).second)
+                    change = true;
+            }
+        }
+    }
+    /* 判断右部的符号时还要用到原来的非终结符，先筛选产生式 */
+    Grammar old = grammar;
+    grammar.prods.clear();
+    std::string removed;
+    for (int i = 0; i < old.prods.size(); i++) {
+        auto &P = old.prods[i];
+        bool ok = reachable.count(P.left) > 0;
+        for (int k = 0; k < P.rigths.size() && ok; k++) {
+            ok = !nonterm.count(P.rigths[k]) || productive.count(P.rigths[k]);
+        }
+        if (ok) {
+            grammar.prods.push_back(P);
+        } else {
+            removed += std::string(removed.empty() ? "" : ", ") + P.left + "->" + std::string(P.rigths.begin(), P.rigths.end());
+        }
+    }
+    grammar.num = grammar.prods.size();
+    grammar.N.clear();
+    grammar.T.clear();
+    std::string droppedN, droppedT;
+    for (int i = 0; i < old.N.size(); i++) {
+        if (reachable.count(old.N[i]) && productive.count(old.N[i])) {
+            grammar.N.push_back(old.N[i]);
+        } else {
+            droppedN += old.N[i];
+        }
+    }
+    for (int i = 0; i < old.T.size(); i++) {
+        if (reachable.count(old.T[i])) {
+            grammar.T.push_back(old.T[i]);
+        } else {
+            droppedT += old.T[i];
+        }
+    }
+    if (!removed.empty() || !droppedN.empty() || !droppedT.empty()) {
+        printf("reduce: removed non-terminators {%s}, terminators {%s}, %d productions: %s\n", droppedN.c_str(),
+               droppedT.c_str(), (int)(old.prods.size() - grammar.prods.size()), removed.c_str());
+    }
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/* LL1、SLR1、LR1三个分析程序共用的分析跟踪和延迟统计 */
+
+/* 分析过程跟踪：编译时定义PARSE_TRACE(g++ -DPARSE_TRACE)才记录事件，每个线程一个环形缓冲区，
+ * 保存最近的TRACE_SIZE个事件。不定义时TRACE_EVENT展开为空，分析循环没有额外开销 */
+#ifdef PARSE_TRACE
+const unsigned TRACE_SIZE = 4096;  // 2的幂
+/* LL1记录匹配、展开、出错(TRACE_MISMATCH)和接受，SLR1、LR1记录移进、规约、转移、出错和接受 */
+const char TRACE_MATCH = 0, TRACE_EXPAND = 1, TRACE_MISMATCH = 2, TRACE_SHIFT = 3, TRACE_REDUCE = 4,
+           TRACE_GOTO = 5, TRACE_ERROR = 6, TRACE_ACCEPT = 7;
+/* 事件：where为LL1的栈深度或LR的所在状态(转移事件为转移到的状态)，pos为输入位置，value为匹配的终结符、
+ * 展开或规约的产生式、移进到的状态、转移的非终结符、LL1出错时的栈顶符号或LR出错时的输入符号 */
+struct TraceEvent {
+    char kind;
+    int where;
+    int pos;
+    int value;
+};
+thread_local TraceEvent traceRing[TRACE_SIZE];
+thread_local unsigned traceCount;
+#define TRACE_EVENT(k, w, p, v) (traceRing[traceCount++ & (TRACE_SIZE - 1)] = TraceEvent{(k), (w), (p), (v)})
+
+/* 输出环形缓冲区中保存的事件 */
+inline void printTrace()
+{
+    unsigned n = traceCount < TRACE_SIZE ? traceCount : TRACE_SIZE;
+    printf("trace: last %u of %u events\n", n, traceCount);
+    for (unsigned k = traceCount - n; k != traceCount; k++) {
+        TraceEvent &e = traceRing[k & (TRACE_SIZE - 1)];
+        if (e.kind == TRACE_MATCH) {
+            printf("  match   depth %d at %d: %c\n", e.where, e.pos, e.value);
+        } else if (e.kind == TRACE_EXPAND) {
+            printf("  expand  depth %d at %d by %d\n", e.where, e.pos, e.value);
+        } else if (e.kind == TRACE_MISMATCH) {
+            printf("  error   depth %d at %d, top %c\n", e.where, e.pos, e.value);
+        } else if (e.kind == TRACE_SHIFT) {
+            printf("  shift   state %d at %d -> %d\n", e.where, e.pos, e.value);
+        } else if (e.kind == TRACE_REDUCE) {
+            printf("  reduce  state %d at %d by %d\n", e.where, e.pos, e.value);
+        } else if (e.kind == TRACE_GOTO) {
+            printf("  goto    state %d on %c\n", e.where, e.value);
+        } else if (e.kind == TRACE_ERROR) {
+            printf("  error   state %d at %d on %c\n", e.where, e.pos, e.value);
+        } else {
+            printf("  accept  at %d\n", e.pos);
+        }
+    }
+}
+#else
+#define TRACE_EVENT(k, w, p, v) ((void)0)
+
+inline void printTrace()
+{
+    printf("trace: not compiled in, rebuild with -DPARSE_TRACE\n");
+}
+#endif
+
+/* 读入语料，每行一个串，加上结束符$ */
+inline bool readCorpus(const std::string &file, std::vector<std::string> &corpus)
+{
+    std::ifstream in(file.c_str());
+    std::string line;
+    while (in >> line) {
+        corpus.push_back(line + '$');
+    }
+    return !corpus.empty();
+}
+
+/* 按2的幂分桶的延迟直方图，第b个桶为[2^b, 2^(b+1))纳秒 */
+inline void writeLatencyJson(const std::string &file, const std::vector<long long> &ns, int accepted)
+{
+    std::vector<long long> sorted(ns);
+    std::sort(sorted.begin(), sorted.end());
+    int n = sorted.size();
+    /* 第q分位数取排序后第ceil(q*n)个 */
+    long long p50 = sorted[std::max(0, (int)ceil(0.5 * n) - 1)];
+    long long p99 = sorted[std::max(0, (int)ceil(0.99 * n) - 1)];
+    long long p999 = sorted[std::max(0, (int)ceil(0.999 * n) - 1)];
+    std::vector<int> buckets(64, 0);
+    for (int k = 0; k < n; k++) {
+        int b = 0;
+        while (b < 63 && (2LL << b) <= sorted[k]) {
+            b++;
+        }
+        buckets[b]++;
+    }
+    FILE *f = fopen(file.c_str(), "w");
+    if (!f) {
+        printf("cannot write %s\n", file.c_str());
+        return;
+    }
+    fprintf(f, "{\"inputs\": %d, \"accepted\": %d, \"p50_ns\": %lld, \"p99_ns\": %lld, \"p999_ns\": %lld, \"max_ns\": %lld,\n",
+            n, accepted, p50, p99, p999, sorted[n - 1]);
+    fprintf(f, " \"histogram\": [");
+    bool comma = false;
+    for (int b = 0; b < 64; b++) {
+        if (buckets[b]) {
+            fprintf(f, "%s\n  {\"ge_ns\": %lld, \"lt_ns\": %lld, \"count\": %d}", comma ? "," : "", 1LL << b, 2LL << b, buckets[b]);
+            comma = true;
+        }
+    }
+    fprintf(f, "\n ]}\n");
+    fclose(f);
+    printf("latency: %d inputs, p50 %lld ns, p99 %lld ns, p999 %lld ns, written to %s\n", n, p50, p99, p999, file.c_str());
+}
+
+/* 逐个分析语料中的串(先整体分析一遍预热缓存)，记录每个串的分析延迟写到json。
+ * parse分析一个串，接受时返回true，不应有输出 */
+inline void measureLatency(const std::string &corpusFile, const std::string &json, bool (*parse)(const std::string &))
+{
+    std::vector<std::string> corpus;
+    if (!readCorpus(corpusFile, corpus)) {
+        printf("cannot read corpus %s\n", corpusFile.c_str());
+        return;
+    }
+    for (int k = 0; k < corpus.size(); k++) {
+        parse(corpus[k]);
+    }
+    std::vector<long long> ns;
+    int accepted = 0;
+    for (int k = 0; k < corpus.size(); k++) {
+        auto begin = std::chrono::steady_clock::now();
+        if (parse(corpus[k])) {
+            accepted++;
+        }
+        ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+    }
+    writeLatencyJson(json, ns, accepted);
+}
+
+#endif